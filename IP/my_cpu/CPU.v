@@ -15,7 +15,21 @@ module CPU #(
     output wire commit,
     output wire [31:0] commit_pc,
     output wire [31:0] commit_pre_pc,
-    output wire [31:0] commit_pred_pc
+    output wire [31:0] commit_pred_pc,
+
+    // commit statistics (read by the simulator in --fast mode)
+    output wire [63:0] stat_commit,
+    output wire [63:0] stat_b_fwd_total,
+    output wire [63:0] stat_b_fwd_correct,
+    output wire [63:0] stat_b_bwd_total,
+    output wire [63:0] stat_b_bwd_correct,
+    output wire [63:0] stat_jal_total,
+    output wire [63:0] stat_jal_correct,
+    output wire [63:0] stat_jalr_total,
+    output wire [63:0] stat_jalr_correct,
+
+    // why this cycle inserts bubbles (`CPI_*), accumulated by the simulator into a CPI stack
+    output wire [2:0] cpi_event
 );
     // touch signal
     wire f_allow_in;
@@ -23,6 +37,10 @@ module CPU #(
     wire f_to_d_valid;
     wire e_allow_in;
     wire d_to_e_valid;
+    wire d_load_use;
+    wire f_icache_miss;
+    wire m_dcache_miss;
+    wire [`HPM_NR_EVENT:1] hpm_event;
     wire m_allow_in;
     wire e_to_m_valid;
     wire w_allow_in;
@@ -216,7 +234,8 @@ module CPU #(
 
         .nw_pc(nw_pc),
 
-        .f_instr(f_instr)
+        .f_instr(f_instr),
+        .f_icache_miss(f_icache_miss)
     );
 
     decode_stage #(
@@ -232,6 +251,7 @@ module CPU #(
         .f_to_d_valid(f_to_d_valid),
         .e_allow_in(e_allow_in),
         .d_to_e_valid(d_to_e_valid),
+        .d_load_use(d_load_use),
 
         .fact_success(fact_success),
         .e_is_jump_instr(E_is_jump_instr),
@@ -381,7 +401,10 @@ module CPU #(
         .E_cur_pc(E_cur_pc),
         .E_instr(E_instr),
         .E_commit(E_commit),
-        .E_pred_pc(E_pred_pc)
+        .E_pred_pc(E_pred_pc),
+
+        .retire(W_commit),
+        .hpm_event(hpm_event)
     );
 
     memory_access_stage memory_access(
@@ -423,7 +446,9 @@ module CPU #(
         .M_instr(M_instr),
         .M_commit(M_commit),
         .M_pred_pc(M_pred_pc),
-        .M_predicted_pc(M_predicted_pc)
+        .M_predicted_pc(M_predicted_pc),
+
+        .m_dcache_miss(m_dcache_miss)
     );
 
     write_back_stage write_back(
@@ -460,6 +485,42 @@ module CPU #(
         .W_predicted_pc(W_predicted_pc)
     );
 
+    commit_stat u_commit_stat(
+        .clk(clk),
+        .rst(rst),
+
+        .commit(W_commit),
+        .instr(W_instr),
+        .actual_pc(W_pred_pc),
+        .pred_pc(W_predicted_pc),
+
+        .commit_cnt(stat_commit),
+        .b_fwd_total(stat_b_fwd_total),
+        .b_fwd_correct(stat_b_fwd_correct),
+        .b_bwd_total(stat_b_bwd_total),
+        .b_bwd_correct(stat_b_bwd_correct),
+        .jal_total(stat_jal_total),
+        .jal_correct(stat_jal_correct),
+        .jalr_total(stat_jalr_total),
+        .jalr_correct(stat_jalr_correct)
+    );
+
+    // a mispredicted control-flow instruction in execute squashes fetch and decode
+    wire e_redirect = !fact_success && E_is_jump_instr && e_valid;
+    assign cpi_event = e_redirect ? ((E_opcode == `OP_SYSTEM) ? `CPI_SYS_REDIRECT :
+                                     (E_opcode == `OP_JALR)   ? `CPI_JALR_MISPRED : `CPI_BR_MISPRED) :
+                       d_load_use ? `CPI_LOAD_USE : `CPI_NONE;
+
+    // mhpmcounter events (numbers in define.v)
+    wire e_is_ret = (E_opcode == `OP_JALR) && (E_instr[11:7] == 5'd0) && (E_instr[19:15] == 5'd1);
+    assign hpm_event[`HPM_BR_MISPRED]   = e_redirect && fact_is_cond_br;
+    assign hpm_event[`HPM_JALR_MISPRED] = e_redirect && fact_is_jalr;
+    assign hpm_event[`HPM_RAS_HIT]      = e_valid && e_is_ret && fact_success;
+    assign hpm_event[`HPM_ICACHE_MISS]  = f_icache_miss;
+    assign hpm_event[`HPM_DCACHE_MISS]  = m_dcache_miss;
+    assign hpm_event[`HPM_LOAD_USE]     = d_load_use;
+    assign hpm_event[`HPM_MULDIV]       = e_valid && (E_opcode == `OP_R) && (E_instr[31:25] == 7'b0000001);
+
     assign F_pc = nw_pc;
 
     // write cpu interface
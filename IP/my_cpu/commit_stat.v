@@ -0,0 +1,65 @@
+`include "define.v"
+// commit-side PC prediction statistics, counted at write back.
+// The simulator reads these in --fast mode instead of decoding every
+// committed instruction on the host.
+module commit_stat (
+    input wire clk,
+    input wire rst,
+
+    input wire commit,
+    input wire [31:0] instr,
+    input wire [31:0] actual_pc,  // resolved next pc
+    input wire [31:0] pred_pc,    // predicted next pc
+
+    output reg [63:0] commit_cnt,
+    output reg [63:0] b_fwd_total,
+    output reg [63:0] b_fwd_correct,
+    output reg [63:0] b_bwd_total,
+    output reg [63:0] b_bwd_correct,
+    output reg [63:0] jal_total,
+    output reg [63:0] jal_correct,
+    output reg [63:0] jalr_total,
+    output reg [63:0] jalr_correct
+);
+    wire [6:0] opcode = instr[6:0];
+    wire correct = (actual_pc == pred_pc);
+
+    wire is_b = (opcode == `OP_B);
+    // imm_b[12] = instr[31]: negative offset means a backward branch
+    wire is_bwd = instr[31];
+    wire is_jal = (opcode == `OP_JAL);
+    wire is_jalr = (opcode == `OP_JALR);
+
+    always @(posedge clk) begin
+        if (rst) begin
+            commit_cnt <= 64'd0;
+            b_fwd_total <= 64'd0;
+            b_fwd_correct <= 64'd0;
+            b_bwd_total <= 64'd0;
+            b_bwd_correct <= 64'd0;
+            jal_total <= 64'd0;
+            jal_correct <= 64'd0;
+            jalr_total <= 64'd0;
+            jalr_correct <= 64'd0;
+        end
+        else if (commit) begin
+            commit_cnt <= commit_cnt + 64'd1;
+            if (is_b && !is_bwd) begin
+                b_fwd_total <= b_fwd_total + 64'd1;
+                if (correct) b_fwd_correct <= b_fwd_correct + 64'd1;
+            end
+            if (is_b && is_bwd) begin
+                b_bwd_total <= b_bwd_total + 64'd1;
+                if (correct) b_bwd_correct <= b_bwd_correct + 64'd1;
+            end
+            if (is_jal) begin
+                jal_total <= jal_total + 64'd1;
+                if (correct) jal_correct <= jal_correct + 64'd1;
+            end
+            if (is_jalr) begin
+                jalr_total <= jalr_total + 64'd1;
+                if (correct) jalr_correct <= jalr_correct + 64'd1;
+            end
+        end
+    end
+endmodule
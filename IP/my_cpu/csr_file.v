@@ -1,5 +1,7 @@
 `include "define.v"
-module csr_file (
+module csr_file #(
+    parameter integer NR_HPM = 8        // mhpmcounter3 .. mhpmcounter(3+NR_HPM-1)
+) (
     input  wire        clk,
     input  wire        rst,
 
@@ -15,7 +17,8 @@ module csr_file (
     output wire [31:0] mtvec_out,
     output wire [31:0] mepc_out,
 
-    input  wire        instret_inc
+    input  wire        instret_inc,
+    input  wire [`HPM_NR_EVENT:1] hpm_event
 );
     // machine CSRs (subset)
     reg [31:0] mstatus;   // 0x300
@@ -28,6 +31,12 @@ module csr_file (
 
     reg [63:0] mcycle;
     reg [63:0] minstret;
+    reg [63:0] mhpmcounter [0:NR_HPM-1];
+    reg [31:0] mhpmevent   [0:NR_HPM-1];
+    integer i;
+
+    // reset values come from the simulator (0, or the fast-forward state)
+    import "DPI-C" function int dpi_reset_csr (input int addr);
 
     assign mtvec_out = mtvec;
     assign mepc_out  = mepc;
@@ -47,8 +56,18 @@ module csr_file (
             12'hC80: rdata_r = mcycle[63:32];
             12'hC02: rdata_r = minstret[31:0];
             12'hC82: rdata_r = minstret[63:32];
+            12'hB00: rdata_r = mcycle[31:0];
+            12'hB80: rdata_r = mcycle[63:32];
+            12'hB02: rdata_r = minstret[31:0];
+            12'hB82: rdata_r = minstret[63:32];
             default: rdata_r = 32'd0;
         endcase
+        // mhpmcounterN (0xB03+) / hpmcounterN (0xC03+, same value), mhpmeventN (0x323+)
+        for (i = 0; i < NR_HPM; i = i + 1) begin
+            if (csr_addr == 12'hB03 + i[11:0] || csr_addr == 12'hC03 + i[11:0]) rdata_r = mhpmcounter[i][31:0];
+            if (csr_addr == 12'hB83 + i[11:0] || csr_addr == 12'hC83 + i[11:0]) rdata_r = mhpmcounter[i][63:32];
+            if (csr_addr == 12'h323 + i[11:0]) rdata_r = mhpmevent[i];
+        end
     end
     assign csr_rdata = rdata_r;
 
@@ -78,21 +97,31 @@ module csr_file (
 
     always @(posedge clk) begin
         if (rst) begin
-            mstatus  <= 32'd0;
+            mstatus  <= dpi_reset_csr(32'h300);
             mie      <= 32'd0;
-            mtvec    <= 32'd0;
+            mtvec    <= dpi_reset_csr(32'h305);
             mscratch <= 32'd0;
-            mepc     <= 32'd0;
-            mcause   <= 32'd0;
+            mepc     <= dpi_reset_csr(32'h341);
+            mcause   <= dpi_reset_csr(32'h342);
             mip      <= 32'd0;
             mcycle   <= 64'd0;
             minstret <= 64'd0;
+            for (i = 0; i < NR_HPM; i = i + 1) begin
+                mhpmcounter[i] <= 64'd0;
+                mhpmevent[i]   <= 32'd0;
+            end
         end
         else begin
             mcycle <= mcycle + 64'd1;
             if (instret_inc) begin
                 minstret <= minstret + 64'd1;
             end
+            for (i = 0; i < NR_HPM; i = i + 1) begin
+                if (mhpmevent[i] != 32'd0 && mhpmevent[i] <= `HPM_NR_EVENT &&
+                    hpm_event[mhpmevent[i][2:0]]) begin
+                    mhpmcounter[i] <= mhpmcounter[i] + 64'd1;
+                end
+            end
 
             if (do_ecall) begin
                 mepc   <= cur_pc;
@@ -120,8 +149,17 @@ module csr_file (
                     12'hC80: mcycle[63 : 32] <= write_data;
                     12'hC02: minstret[31 : 0] <= write_data;
                     12'hC82: minstret[63 : 32] <= write_data;
+                    12'hB00: mcycle[31 : 0] <= write_data;
+                    12'hB80: mcycle[63 : 32] <= write_data;
+                    12'hB02: minstret[31 : 0] <= write_data;
+                    12'hB82: minstret[63 : 32] <= write_data;
                     default: ;
                 endcase
+                for (i = 0; i < NR_HPM; i = i + 1) begin
+                    if (csr_addr == 12'hB03 + i[11:0]) mhpmcounter[i][31 : 0]  <= write_data;
+                    if (csr_addr == 12'hB83 + i[11:0]) mhpmcounter[i][63 : 32] <= write_data;
+                    if (csr_addr == 12'h323 + i[11:0]) mhpmevent[i] <= write_data;
+                end
             end
         end
     end
@@ -13,6 +13,7 @@ module decode_stage #(
     input wire f_to_d_valid,
     input wire e_allow_in,
     output wire d_to_e_valid,
+    output wire d_load_use,     // stalled on a load in execute (CPI stack)
 
 	// control hazards judge
 	input wire fact_success,
@@ -110,10 +111,11 @@ module decode_stage #(
 		(D_instr_type == `TYPEB)    
 	);
 
-    wire w_en = (W_opcode == `OP_LOAD) | (W_opcode == `OP_JAL)
+    // W_* keep their old value while w_valid is low, so only write on a valid write back
+    wire w_en = w_valid && ((W_opcode == `OP_LOAD) | (W_opcode == `OP_JAL)
 		| (W_opcode == `OP_JALR) | (W_opcode == `OP_R)
 		| (W_opcode == `OP_IMM) | (W_opcode == `OP_LUI)
-		| (W_opcode == `OP_AUIPC) | (W_opcode == `OP_SYSTEM);
+		| (W_opcode == `OP_AUIPC) | (W_opcode == `OP_SYSTEM));
 	
 	wire [31:0] wdata;
 	assign wdata = (W_opcode == `OP_LOAD) ? W_valM
@@ -196,6 +198,7 @@ module decode_stage #(
     wire d_ready_go = ~((((valid_src1 && (E_rd == D_rs1)) || (valid_src2 && (E_rd == D_rs2))) &&
                          (E_opcode == `OP_LOAD) && e_valid));
     assign d_allow_in = ~d_valid || (d_ready_go && e_allow_in);
+    assign d_load_use = d_valid && !d_ready_go;
 
     always@ (posedge clk) begin
         if (rst) begin
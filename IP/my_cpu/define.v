@@ -51,3 +51,18 @@
 `define FUNC_SB     10'b0000000000
 `define FUNC_SH     10'b0000000001
 `define FUNC_SW     10'b0000000010
+// CPU.cpi_event: bubbles inserted this cycle (the simulator mirrors these in sim.c)
+`define CPI_NONE          3'd0
+`define CPI_LOAD_USE      3'd1
+`define CPI_BR_MISPRED    3'd2
+`define CPI_JALR_MISPRED  3'd3
+`define CPI_SYS_REDIRECT  3'd4
+// mhpmevent3..10 values: counter i counts cycles with hpm_event[mhpmevent_i] set (0 = off)
+`define HPM_NR_EVENT      7
+`define HPM_BR_MISPRED    1   // conditional branch mispredicted in execute
+`define HPM_JALR_MISPRED  2   // JALR mispredicted in execute
+`define HPM_RAS_HIT       3   // return (jalr x0, 0(ra)) predicted correctly
+`define HPM_ICACHE_MISS   4   // instruction fetched from memory
+`define HPM_DCACHE_MISS   5   // load served from memory
+`define HPM_LOAD_USE      6   // decode stalled on a load-use hazard
+`define HPM_MULDIV        7   // M-extension instruction in execute
@@ -77,7 +77,11 @@ module execute_stage #(
     output reg [31:0] E_cur_pc,
     output reg [31:0] E_instr,
     output reg E_commit,
-    output reg [31:0] E_pred_pc
+    output reg [31:0] E_pred_pc,
+
+    // minstret / mhpmcounter inputs
+    input wire retire,
+    input wire [`HPM_NR_EVENT:1] hpm_event
 );
 	// execute function
     // ==================== CSR / SYSTEM ====================
@@ -99,9 +103,6 @@ module execute_stage #(
     wire [31:0] csr_mtvec;
     wire [31:0] csr_mepc;
 
-    // retire count: approximate with writeback commit (wired in from CPU top later if needed)
-    wire instret_inc = E_commit && e_valid;
-
     csr_file u_csr (
         .clk        (clk),
         .rst        (rst),
@@ -115,7 +116,8 @@ module execute_stage #(
         .cur_pc     (E_pc),
         .mtvec_out  (csr_mtvec),
         .mepc_out   (csr_mepc),
-        .instret_inc(instret_inc)
+        .instret_inc(retire),
+        .hpm_event  (hpm_event)
     );
 
     wire sys_redirect = (is_ecall || is_mret) && e_valid;
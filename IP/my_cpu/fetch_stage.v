@@ -64,7 +64,8 @@ module fetch_stage # (
     output reg [31:0] nw_pc,
 
     // signal for cpu interface
-    output wire [31:0] f_instr
+    output wire [31:0] f_instr,
+    output wire f_icache_miss
 );
     // DPI import for I-Cache memory interface
     import "DPI-C" function int dpi_mem_read (input int addr, input int len);
@@ -86,8 +87,16 @@ module fetch_stage # (
         .w_addr(F_pc),
         .w_data(f_instr)
     );
+    assign f_icache_miss = !hit && f_to_d_valid;
 
+`ifdef NPC_PMEM_DPI
     assign f_instr = hit ? r_data : dpi_mem_read(F_pc, 4);
+`else
+    // pmem is read through a pointer (include/npc_pmem.h), only addresses
+    // outside [0x80000000, 0x88000000) take the DPI call
+    assign f_instr = hit ? r_data :
+                     (F_pc[31:27] == 5'b10000) ? $c32("NPC_PMEM_READ32(", F_pc, ")") : dpi_mem_read(F_pc, 4);
+`endif
 
     // fetch function
     wire [2:0] func3;
@@ -307,11 +316,13 @@ module fetch_stage # (
     // assign f_spec_local_taken   = old1_l_taken;
 
     // update PC
+    // reset pc comes from the simulator (RESET_VECTOR, or the fast-forward pc)
+    import "DPI-C" function int dpi_reset_pc ();
     wire e_train_valid_jump = e_stage_is_jump_instr && e_stage_valid;
     wire e_train_redirect   = e_train_valid_jump && !e_pred_correct;
     always@ (posedge clk) begin
         if (rst) begin
-            nw_pc <= 32'h80000000;
+            nw_pc <= dpi_reset_pc();
         end
         else if (e_train_redirect) begin
             nw_pc <= e_redirect_pc;
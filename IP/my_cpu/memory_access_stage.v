@@ -45,7 +45,10 @@ module memory_access_stage(
     output reg [31:0] M_instr,
     output reg M_commit,
     output reg [31:0] M_pred_pc,
-    output reg [31:0] M_predicted_pc
+    output reg [31:0] M_predicted_pc,
+
+    // performance events
+    output wire m_dcache_miss
 );
 
     // memory access function
@@ -55,6 +58,7 @@ module memory_access_stage(
     wire [31:0] mem_addr = mem_access ? M_valE : 32'd0;
 	wire [31:0] wdata = is_s ? M_val2 : 32'd0;
 
+    wire r_miss;
     ram u_ram(
         .clk(clk),
         .rst(rst),
@@ -63,8 +67,10 @@ module memory_access_stage(
         .funct(M_funct),
         .addr(mem_addr),
         .wdata(wdata),
-        .rdata(m_valM)
+        .rdata(m_valM),
+        .r_miss(r_miss)
     );
+    assign m_dcache_miss = m_valid && r_miss;
 
     // pipeline control
     // m_ready_go: ready when no memory access, or D-Cache responds
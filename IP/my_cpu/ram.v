@@ -7,7 +7,8 @@ module ram(
 	input wire [9:0] funct,
 	input wire [31:0] addr,
 	input wire [31:0] wdata,
-	output wire [31:0] rdata
+	output wire [31:0] rdata,
+	output wire r_miss
 );	
 	import "DPI-C" function void dpi_mem_write(input int addr, input int data, int len);
 	import "DPI-C" function int dpi_mem_read (input int addr, input int len);
@@ -29,8 +30,18 @@ module ram(
 		.w_data(wdata)
 	);
 
-	wire [31:0] mem = (addr >= 32'h80000000 && addr <= 32'h87ffffff) 
-		? (hit ? rdata_from_dcache : dpi_mem_read(addr, 4)) : 32'd0; 
+	wire in_pmem = (addr >= 32'h80000000 && addr <= 32'h87ffffff);
+`ifdef NPC_PMEM_DPI
+	wire [31:0] mem = in_pmem ? (hit ? rdata_from_dcache : dpi_mem_read(addr, 4)) : 32'd0;
+`else
+	// loads read pmem through a pointer (include/npc_pmem.h); stores stay on
+	// dpi_mem_write, which also handles MMIO and the dirty-page bookkeeping.
+	// The pointer read is 4 bytes wide: the last 3 bytes of pmem take the DPI call.
+	wire [31:0] mem = in_pmem ? (hit ? rdata_from_dcache :
+	                             (addr + 32'd3 <= 32'h87ffffff) ? $c32("NPC_PMEM_READ32(", addr, ")") : dpi_mem_read(addr, 4))
+	                          : 32'd0;
+`endif
+	assign r_miss = r_en && in_pmem && !hit;
     wire [31:0] load_word = mem;
     wire [15:0] load_half = mem[15:0];
     wire  [7:0] load_byte = mem[7:0];
@@ -21,4 +21,4 @@ image: $(IMAGE).elf
 	@echo + OBJCOPY "->" $(IMAGE_REL).bin
 	@$(OBJCOPY) -S --set-section-flags .bss=alloc,contents -O binary $(IMAGE).elf $(IMAGE).bin
 run: image
-	$(MAKE) -C $(SIM_HOME) run IMAGE=$(IMAGE).bin
\ No newline at end of file
+	$(MAKE) -C $(SIM_HOME) run IMAGE=$(IMAGE).bin ELF=$(IMAGE).elf
\ No newline at end of file
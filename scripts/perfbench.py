@@ -0,0 +1,207 @@
+#!/usr/bin/env python3
+"""Simulator throughput benchmark (make -C simulator perfbench).
+
+Every build configuration (PERF_CFGS, default debug release pgo) runs a fixed
+set of workloads in batch --fast mode:
+
+  coremark, dhrystone     the default images
+  microbench-test         microbench built with mainargs=test
+  pcpred-mix-800k         the cpu-test software-test/cpu-tests/tests/pcpred-mix-800k.c,
+                          which loops forever, stopped at 800k commits
+
+and records host instructions per second and cycles per second (from the
+simulator's --stats, i.e. time inside cpu_exec) and peak RSS.  Each workload
+runs REPEAT times and keeps the fastest run.  The results are compared to a
+checked-in baseline (simulator/perfbench_baseline.json): a speed drop or an
+RSS growth above THRESHOLD percent is a regression and the exit code is 1, as
+is a workload missing from the baseline.  An empty baseline fails before
+anything runs.
+--update writes the results as the new baseline; the checked-in baseline is
+empty, so the first run on the reference host has to be
+make -C simulator perfbench PERF_UPDATE=1, and its perfbench_baseline.json
+committed.  Numbers only compare on the
+same host, so the baseline records the CPU model and a mismatch is reported.
+"""
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import time
+
+CPU_HOME = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+ARCH = "riscv32-npc"
+MIX_COMMITS = 800000
+METRICS = (("inst_per_sec", "higher"), ("cycle_per_sec", "higher"), ("peak_rss_kb", "lower"))
+
+
+def sh(cmd, **kw):
+    print("[INFO]", " ".join(cmd), flush=True)
+    subprocess.check_call(cmd, **kw)
+
+
+def host_cpu():
+    try:
+        with open("/proc/cpuinfo") as f:
+            for line in f:
+                if line.startswith("model name"):
+                    return line.split(":", 1)[1].strip()
+    except OSError:
+        pass
+    return os.uname().machine
+
+
+# ------------------------------------------------------------------ images
+def build_images(sim_home, img_dir):
+    """Builds the benchmark images and copies them to img_dir, returns name -> path."""
+    am_home = os.path.join(CPU_HOME, "abstract-machine")
+    os.makedirs(img_dir, exist_ok=True)
+
+    def am_make(bench, *extra):
+        sh(["make", "-C", os.path.join(CPU_HOME, "software-test", "benchmarks", bench), f"ARCH={ARCH}",
+            f"AM_HOME={am_home}", f"SIM_HOME={sim_home}", *extra], stdout=subprocess.DEVNULL)
+
+    def copy(bench, name):
+        src = os.path.join(CPU_HOME, "software-test", "benchmarks", bench, "build", f"{bench}-{ARCH}.bin")
+        dst = os.path.join(img_dir, name + ".bin")
+        shutil.copy(src, dst)
+        return dst
+
+    images = {}
+    for bench in ("coremark", "dhrystone"):
+        am_make(bench, "image")
+        images[bench] = copy(bench, bench)
+    # mainargs is compiled into AM's trm.c, which npc.mk rebuilds on every make
+    am_make("microbench", "image", "mainargs=test")
+    images["microbench-test"] = copy("microbench", "microbench-test")
+    # cpu-tests builds one image per tests/*.c, ALL picks the one we need
+    tests = os.path.join(CPU_HOME, "software-test", "cpu-tests")
+    sh(["make", "-C", tests, f"ARCH={ARCH}", f"AM_HOME={am_home}", f"SIM_HOME={sim_home}", "ALL=pcpred-mix-800k"],
+       stdout=subprocess.DEVNULL)
+    images["pcpred-mix-800k"] = os.path.join(img_dir, "pcpred-mix-800k.bin")
+    shutil.copy(os.path.join(tests, "build", f"pcpred-mix-800k-{ARCH}.bin"), images["pcpred-mix-800k"])
+    return images
+
+
+def workloads(images):
+    return {
+        "coremark": [(images["coremark"], [])],
+        "dhrystone": [(images["dhrystone"], [])],
+        "microbench-test": [(images["microbench-test"], [])],
+        "pcpred-mix-800k": [(images["pcpred-mix-800k"], [f"--max-commit={MIX_COMMITS}"])],
+    }
+
+
+# ------------------------------------------------------------------ runs
+def run_once(sim, image, extra, out_dir, tag):
+    """One simulator run: (commits, cycles, host_us, peak_rss_kb)."""
+    stats = os.path.join(out_dir, tag + ".stats.json")
+    log = os.path.join(out_dir, tag + ".log")
+    if os.path.exists(stats):
+        os.remove(stats)
+    cmd = [sim, "--batch", "--fast", "--no-itrace", f"--log={log}", f"--stats={stats}"] + extra + [image]
+    with open(os.devnull, "w") as null:
+        p = subprocess.Popen(cmd, stdout=null, stderr=subprocess.STDOUT, stdin=subprocess.DEVNULL)
+        _, status, ru = os.wait4(p.pid, 0)
+    if os.waitstatus_to_exitcode(status) != 0:
+        raise RuntimeError(f"{' '.join(cmd)} failed, see {log}")
+    with open(stats) as f:
+        s = json.load(f)["final"]["stats"]
+    return s["sim.commit"], s["sim.cycle"], s["host.time_us"], ru.ru_maxrss
+
+
+def measure(sim, runs, out_dir, tag, repeat):
+    best = None
+    for r in range(repeat):
+        inst = cycle = us = rss = 0
+        for i, (image, extra) in enumerate(runs):
+            a, b, c, d = run_once(sim, image, extra, out_dir, f"{tag}-{i}-{r}")
+            inst, cycle, us, rss = inst + a, cycle + b, us + c, max(rss, d)
+        if us == 0:
+            raise RuntimeError(f"{tag}: no host time recorded")
+        res = {"inst": inst, "cycle": cycle, "inst_per_sec": inst * 1e6 / us,
+               "cycle_per_sec": cycle * 1e6 / us, "peak_rss_kb": rss}
+        if best is None or res["inst_per_sec"] > best["inst_per_sec"]:
+            best = res
+        best["peak_rss_kb"] = max(best["peak_rss_kb"], rss)
+    return best
+
+
+# ------------------------------------------------------------------ compare
+def compare(results, baseline, threshold):
+    """Prints the table, returns the list of regressions."""
+    base = baseline.get("results", {})
+    bad = []
+    print(f"{'config':<8} {'workload':<16} {'KIPS':>10} {'KCPS':>10} {'RSS MB':>8}  vs baseline")
+    for cfg, wl in results.items():
+        for name, r in wl.items():
+            b = base.get(cfg, {}).get(name)
+            notes = []
+            if not b:
+                bad.append(f"{cfg}/{name}: not in the baseline")
+            for key, better in METRICS:
+                if not b or not b.get(key):
+                    continue
+                delta = (r[key] - b[key]) * 100.0 / b[key]
+                notes.append(f"{key} {delta:+.1f}%")
+                worse = -delta if better == "higher" else delta
+                if worse > threshold:
+                    bad.append(f"{cfg}/{name}: {key} {b[key]:.0f} -> {r[key]:.0f} ({delta:+.1f}%)")
+            print(f"{cfg:<8} {name:<16} {r['inst_per_sec'] / 1e3:>10.1f} {r['cycle_per_sec'] / 1e3:>10.1f} "
+                  f"{r['peak_rss_kb'] / 1024:>8.1f}  {', '.join(notes) if notes else 'no baseline'}")
+    return bad
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--sim-home", default=os.path.join(CPU_HOME, "simulator"))
+    ap.add_argument("--cfgs", default="debug release pgo", help="build configurations, space separated")
+    ap.add_argument("--baseline", help="default SIM_HOME/perfbench_baseline.json")
+    ap.add_argument("--threshold", type=float, default=10.0, help="regression threshold in percent")
+    ap.add_argument("--repeat", type=int, default=3)
+    ap.add_argument("--update", action="store_true", help="write the results as the new baseline")
+    args = ap.parse_args()
+    baseline_file = args.baseline or os.path.join(args.sim_home, "perfbench_baseline.json")
+    out_dir = os.path.join(args.sim_home, "build", "perfbench")
+    os.makedirs(out_dir, exist_ok=True)
+    try:
+        with open(baseline_file) as f:
+            baseline = json.load(f)
+    except (OSError, ValueError):
+        baseline = {}
+    # an empty baseline would pass every run: only --update may start from one
+    if not baseline.get("results") and not args.update:
+        sys.exit(f"[ERROR] {baseline_file} has no results: record them on the reference host with "
+                 f"make -C simulator perfbench PERF_UPDATE=1")
+
+    wl = workloads(build_images(args.sim_home, os.path.join(out_dir, "images")))
+    results = {}
+    start = time.time()
+    for cfg in args.cfgs.split():
+        sim = os.path.join(args.sim_home, "build", cfg, "CPU")
+        if not os.path.exists(sim):
+            sys.exit(f"[ERROR] {sim} not found, build it with make -C {args.sim_home} {cfg}")
+        results[cfg] = {name: measure(sim, runs, out_dir, f"{cfg}-{name}", args.repeat) for name, runs in wl.items()}
+
+    current = {"host": host_cpu(), "date": time.strftime("%Y-%m-%d"), "results": results}
+    with open(os.path.join(out_dir, "results.json"), "w") as f:
+        json.dump(current, f, indent=2)
+    if baseline.get("results") and baseline.get("host") != current["host"]:
+        print(f"[WARN] baseline was recorded on '{baseline['host']}', this host is '{current['host']}'")
+
+    bad = compare(results, baseline, args.threshold)
+    print(f"[INFO] {time.time() - start:.1f}s, results in {os.path.join(out_dir, 'results.json')}")
+    if args.update:
+        with open(baseline_file, "w") as f:
+            json.dump(current, f, indent=2)
+            f.write("\n")
+        print(f"[INFO] baseline updated: {baseline_file}")
+        return 0
+    for line in bad:
+        print(f"[REGRESSION] {line} (threshold {args.threshold:g}%)")
+    return 1 if bad else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
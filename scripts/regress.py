@@ -0,0 +1,212 @@
+#!/usr/bin/env python3
+"""Parallel regression runner for the NPC simulator.
+
+  regress.py cpu-tests        every software-test/cpu-tests image
+  regress.py riscv-tests-am   riscv-tests-am images, one ISA extension at a time
+  regress.py project          the cpu-test WORKLOAD, MAX_COMMIT commits, a window every INTERVAL
+
+The simulator is built once (BUILD_CFG, default release), images are built
+with make -j, then every image runs as its own batch job, JOBS at a time
+(default: all host cores), each with a TIMEOUT in seconds.  Results go to
+simulator/build/pcpred_logs/<suite>/: one log and one --stats JSON per job,
+and pcpred_summary.csv, whose leading columns are the ones the top-level
+Makefile reports read.
+
+Settings come from the environment so the Makefile can pass them through:
+ARCH AM_HOME SIM_HOME ISA_LIST RISCV_TESTS_HOME BUILD_CFG JOBS TIMEOUT
+MAX_COMMIT INTERVAL WORKLOAD DIFF (1 = run with the NEMU reference).
+"""
+import argparse
+import concurrent.futures
+import glob
+import json
+import os
+import shutil
+import subprocess
+import sys
+import time
+
+CPU_HOME = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def env(name, default):
+    return os.environ.get(name) or default
+
+
+ARCH = env("ARCH", "riscv32-npc")
+AM_HOME = env("AM_HOME", os.path.join(CPU_HOME, "abstract-machine"))
+SIM_HOME = env("SIM_HOME", os.path.join(CPU_HOME, "simulator"))
+BUILD_CFG = env("BUILD_CFG", "release")
+JOBS = int(env("JOBS", str(os.cpu_count() or 1)))
+TIMEOUT = float(env("TIMEOUT", "600"))
+DIFF = env("DIFF", "0") == "1"
+# cpu-tests/pcpred-*.c loop forever ("simulator limits commit count")
+PCPRED_MAX_COMMIT = "800000"
+
+# ------------------------------------------------------------------ stats
+
+# pcpred_summary.csv: label column(s) first, then these.  The Makefile awk
+# reports index them by position, so only ever append.
+STAT_COLS = ["total", "correct", "wrong", "rate",
+             "b_total", "b_correct", "bf_total", "bf_correct",
+             "bb_total", "bb_correct", "jalr_total", "jalr_correct",
+             "status", "insts", "cycles", "ipc", "seconds"]
+STATUS = STAT_COLS.index("status")
+
+
+def summarize(stats_file, status, seconds):
+    """One summary row from the final record of the simulator's --stats JSON."""
+    try:
+        with open(stats_file) as f:
+            s = json.load(f)["final"]["stats"]
+    except (OSError, ValueError, KeyError):
+        s = {}
+
+    def get(key, fmt=None):
+        v = s.get(key)
+        return "NA" if v is None else (fmt.format(v) if fmt else v)
+    row = [get("pcpred.all.total"), get("pcpred.all.correct"), get("pcpred.all.wrong"),
+           get("pcpred.all.rate", "{:.2f}")]
+    for k in ("b", "b_fwd", "b_bwd", "jalr"):
+        row += [get(f"pcpred.{k}.total"), get(f"pcpred.{k}.correct")]
+    row.append(status)
+    row += [get("sim.commit"), get("sim.cycle"), get("sim.ipc", "{:.4f}")]
+    row.append(f"{seconds:.2f}")
+    return row
+
+
+# ------------------------------------------------------------------ jobs
+def sh(cmd, **kw):
+    print("[INFO]", " ".join(cmd), flush=True)
+    subprocess.check_call(cmd, **kw)
+
+
+def build_simulator():
+    sh(["make", "-C", SIM_HOME, BUILD_CFG, f"BUILD_CFG={BUILD_CFG}"])
+    return os.path.join(SIM_HOME, "build", BUILD_CFG, "CPU")
+
+
+def am_make(path, *extra):
+    sh(["make", "-C", path, f"ARCH={ARCH}", f"AM_HOME={AM_HOME}", f"SIM_HOME={SIM_HOME}",
+        f"-j{JOBS}", *extra], stdout=subprocess.DEVNULL)
+
+
+def run_job(sim, job, log_dir, extra_args):
+    labels, image, job_args = job
+    name = "-".join(labels)
+    log = os.path.join(log_dir, name + ".log")
+    stats = os.path.join(log_dir, name + ".stats.json")
+    if os.path.exists(stats):
+        os.remove(stats)
+    cmd = [sim, "--batch", "--fast", "--no-itrace", f"--log={os.path.join(log_dir, name + '-npc-log.txt')}",
+           f"--stats={stats}"]
+    if DIFF:
+        cmd.append(f"--diff={os.path.join(SIM_HOME, 'nemu', 'riscv32-nemu-interpreter-so')}")
+    cmd += extra_args + job_args + [image]
+    start = time.time()
+    try:
+        p = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                           stdin=subprocess.DEVNULL, timeout=TIMEOUT)
+        out = p.stdout.decode(errors="replace")
+        # the simulator exits 0 on HIT GOOD TRAP or on reaching --max-commit
+        status = "PASS" if p.returncode == 0 else "FAIL"
+    except subprocess.TimeoutExpired as e:
+        out = (e.stdout or b"").decode(errors="replace")
+        status = "TIMEOUT"
+    seconds = time.time() - start
+    with open(log, "w") as f:
+        f.write(" ".join(cmd) + "\n" + out)
+    return labels, summarize(stats, status, seconds)
+
+
+def run_suite(suite, label_cols, jobs, extra_args=()):
+    log_dir = os.path.join(SIM_HOME, "build", "pcpred_logs", suite)
+    os.makedirs(log_dir, exist_ok=True)
+    if not jobs:
+        sys.exit(f"[ERROR] no images found for {suite}")
+    sim = build_simulator()
+    print(f"[INFO] {suite}: {len(jobs)} jobs, {JOBS} in parallel, timeout {TIMEOUT:g}s", flush=True)
+
+    start = time.time()
+    rows = []
+    with concurrent.futures.ThreadPoolExecutor(max_workers=JOBS) as pool:
+        futs = [pool.submit(run_job, sim, j, log_dir, list(extra_args)) for j in jobs]
+        for fut in concurrent.futures.as_completed(futs):
+            labels, row = fut.result()
+            rows.append((labels, row))
+            status = row[STATUS]
+            print(f"[{'/'.join(labels):>20}] {status:<7} {row[3]:>6}%  {row[-1]}s", flush=True)
+    rows.sort()
+
+    csv = os.path.join(log_dir, "pcpred_summary.csv")
+    with open(csv, "w") as f:
+        f.write(",".join(label_cols + STAT_COLS) + "\n")
+        for labels, row in rows:
+            f.write(",".join(str(x) for x in list(labels) + row) + "\n")
+    bad = [l for l, r in rows if r[STATUS] != "PASS"]
+    print(f"[INFO] {len(rows) - len(bad)}/{len(rows)} passed in {time.time() - start:.1f}s, wrote {csv}")
+    for l in bad:
+        print(f"[WARN] {'/'.join(l)} did not pass, see {os.path.join(log_dir, '-'.join(l) + '.log')}")
+    return 1 if bad else 0
+
+
+def images(build_dir):
+    suffix = f"-{ARCH}.bin"
+    return sorted((os.path.basename(p)[:-len(suffix)], p) for p in glob.glob(os.path.join(build_dir, "*" + suffix)))
+
+
+# ------------------------------------------------------------------ suites
+def cmd_cpu_tests(args):
+    home = os.path.join(CPU_HOME, "software-test", "cpu-tests")
+    am_make(home, "all")
+    jobs = [((name,), img, [f"--max-commit={PCPRED_MAX_COMMIT}"] if name.startswith("pcpred-") else [])
+            for name, img in images(os.path.join(home, "build"))]
+    return run_suite("cpu-tests", ["test"], jobs)
+
+
+def cmd_riscv_tests(args):
+    home = env("RISCV_TESTS_HOME", os.path.join(CPU_HOME, "software-test", "riscv-tests-am"))
+    if not os.path.isdir(home):
+        sys.exit(f"[ERROR] riscv-tests-am not found at {home}, set RISCV_TESTS_HOME")
+    # Every extension builds into the same build/ directory, so build them one
+    # at a time and keep a copy of each image set before building the next.
+    img_dir = os.path.join(SIM_HOME, "build", "pcpred_logs", "riscv-tests-am", "images")
+    jobs = []
+    for isa in env("ISA_LIST", "i m").split():
+        shutil.rmtree(os.path.join(home, "build"), ignore_errors=True)
+        am_make(home, f"TEST_ISA={isa}")
+        dst = os.path.join(img_dir, isa)
+        os.makedirs(dst, exist_ok=True)
+        for name, img in images(os.path.join(home, "build")):
+            shutil.copy(img, os.path.join(dst, name + ".bin"))
+            jobs.append(((isa, name), os.path.join(dst, name + ".bin"), []))
+    return run_suite("riscv-tests-am", ["isa", "test"], jobs)
+
+
+def cmd_project(args):
+    max_commit = env("MAX_COMMIT", "800000")
+    interval = env("INTERVAL", "50000")
+    workload = env("WORKLOAD", "pcpred-mix-800k")
+    # WORKLOAD is a cpu-test (software-test/cpu-tests/tests/WORKLOAD.c)
+    home = os.path.join(CPU_HOME, "software-test", "cpu-tests")
+    am_make(home, f"ALL={workload}")
+    img = os.path.join(home, "build", f"{workload}-{ARCH}.bin")
+    if not os.path.exists(img):
+        sys.exit(f"[ERROR] {img} was not built, is {workload} a cpu-test?")
+    jobs = [((workload,), img, [])]
+    return run_suite(os.path.join("project", workload), ["workload"], jobs,
+                     [f"--max-commit={max_commit}", f"--stats-interval={interval}"])
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = ap.add_subparsers(dest="suite", required=True)
+    sub.add_parser("cpu-tests").set_defaults(func=cmd_cpu_tests)
+    sub.add_parser("riscv-tests-am").set_defaults(func=cmd_riscv_tests)
+    sub.add_parser("project").set_defaults(func=cmd_project)
+    args = ap.parse_args()
+    return args.func(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,241 @@
+#!/usr/bin/env python3
+"""SimPoint-style sampled simulation for the NPC simulator.
+
+  profile  run the image in the NEMU reference and write basic-block vectors
+  cluster  pick representative intervals (random projection + k-means)
+  run      simulate only those intervals in RTL and print weighted results
+
+Typical flow (coremark):
+  simpoint.py profile --sim BIN --diff NEMU_SO --image IMG --interval 1000000 -o cm.bb
+  simpoint.py cluster cm.bb -k 10 -o cm.simpts
+  simpoint.py run --sim BIN --diff NEMU_SO --image IMG --interval 1000000 \\
+                  --warmup 100000 cm.simpts
+"""
+import argparse
+import json
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+PROJ_DIM = 15
+
+
+# ---------------------------------------------------------------- profile
+def cmd_profile(args):
+    cmd = [args.sim, "--batch", f"--diff={args.diff}", f"--bbv={args.output}",
+           f"--bbv-interval={args.interval}", args.image]
+    print("[INFO]", " ".join(cmd))
+    return subprocess.call(cmd, stdout=subprocess.DEVNULL if args.quiet else None)
+
+
+# ---------------------------------------------------------------- cluster
+def read_bbv(path):
+    vecs = []
+    with open(path) as f:
+        for line in f:
+            if not line.startswith("T"):
+                continue
+            v = {}
+            for item in line[1:].split():
+                _, bb, cnt = item.split(":")
+                v[int(bb)] = int(cnt)
+            vecs.append(v)
+    return vecs
+
+
+def project(vecs, dim, seed):
+    # Normalise each interval to a frequency vector, then project it to `dim`
+    # dimensions with a random matrix in [-1, 1) as SimPoint does.
+    rng = random.Random(seed)
+    cols = {}
+    out = []
+    for v in vecs:
+        total = float(sum(v.values())) or 1.0
+        p = [0.0] * dim
+        for bb, cnt in v.items():
+            col = cols.get(bb)
+            if col is None:
+                col = cols[bb] = [rng.uniform(-1.0, 1.0) for _ in range(dim)]
+            w = cnt / total
+            for d in range(dim):
+                p[d] += w * col[d]
+        out.append(p)
+    return out
+
+
+def dist2(a, b):
+    return sum((x - y) * (x - y) for x, y in zip(a, b))
+
+
+def kmeans(points, k, rng, iters=100):
+    # k-means++ seeding
+    centers = [list(rng.choice(points))]
+    while len(centers) < k:
+        d = [min(dist2(p, c) for c in centers) for p in points]
+        s = sum(d)
+        if s == 0:
+            break
+        r = rng.uniform(0, s)
+        acc = 0.0
+        for p, dp in zip(points, d):
+            acc += dp
+            if acc >= r:
+                centers.append(list(p))
+                break
+    assign = [0] * len(points)
+    for _ in range(iters):
+        changed = False
+        for i, p in enumerate(points):
+            c = min(range(len(centers)), key=lambda j: dist2(p, centers[j]))
+            if c != assign[i]:
+                assign[i] = c
+                changed = True
+        for j in range(len(centers)):
+            members = [p for p, a in zip(points, assign) if a == j]
+            if members:
+                centers[j] = [sum(x) / len(members) for x in zip(*members)]
+        if not changed:
+            break
+    sse = sum(dist2(p, centers[a]) for p, a in zip(points, assign))
+    return centers, assign, sse
+
+
+def cmd_cluster(args):
+    vecs = read_bbv(args.bbv)
+    if not vecs:
+        sys.exit(f"[ERROR] no intervals in {args.bbv}")
+    points = project(vecs, PROJ_DIM, args.seed)
+    k = min(args.k, len(points))
+    rng = random.Random(args.seed)
+    best = None
+    for _ in range(args.restarts):
+        res = kmeans(points, k, rng)
+        if best is None or res[2] < best[2]:
+            best = res
+    centers, assign, sse = best
+
+    picks = []
+    for j, c in enumerate(centers):
+        members = [i for i, a in enumerate(assign) if a == j]
+        if not members:
+            continue
+        rep = min(members, key=lambda i: dist2(points[i], c))
+        picks.append((rep, len(members) / len(points)))
+    picks.sort()
+    with open(args.output, "w") as f:
+        f.write("# interval weight\n")
+        for rep, w in picks:
+            f.write(f"{rep} {w:.6f}\n")
+    print(f"[INFO] {len(points)} intervals -> {len(picks)} simpoints (sse={sse:.4f}), wrote {args.output}")
+    return 0
+
+
+# ---------------------------------------------------------------- run
+def parse_stats(path):
+    """Measured-window counters from the final record of the simulator's --stats JSON."""
+    try:
+        with open(path) as f:
+            s = json.load(f)["final"]["stats"]
+    except (OSError, ValueError, KeyError):
+        return {}
+    r = {"inst": (s["sim.commit"], s["sim.cycle"]),
+         "cf": (s["pcpred.all.total"],), "cf_cor": (s["pcpred.all.correct"],)}
+    for key in ("b", "jalr"):
+        r[key] = (s[f"pcpred.{key}.total"], s[f"pcpred.{key}.correct"])
+    return r
+
+
+def read_simpoints(path):
+    picks = []
+    with open(path) as f:
+        for line in f:
+            line = line.split("#", 1)[0].split()
+            if line:
+                picks.append((int(line[0]), float(line[1])))
+    return picks
+
+
+def cmd_run(args):
+    picks = read_simpoints(args.simpoints)
+    stats = os.path.join(tempfile.mkdtemp(prefix="simpoint-"), "stats.json")
+    cpi = 0.0
+    acc = {"cf": [0.0, 0.0], "b": [0.0, 0.0], "jalr": [0.0, 0.0]}
+    wsum = 0.0
+    print(f"{'interval':>9} {'weight':>8} {'IPC':>7} {'pred%':>7}")
+    for idx, w in picks:
+        start = idx * args.interval
+        ff = max(0, start - args.warmup)
+        cmd = [args.sim, "--fast", "--no-itrace", f"--diff={args.diff}", "--no-diff-check",
+               f"--warmup={start - ff}", f"--max-commit={args.interval}", f"--stats={stats}"]
+        if ff > 0:
+            cmd.append(f"--fast-forward={ff}")
+        cmd += args.extra + [args.image]
+        if os.path.exists(stats):
+            os.remove(stats)
+        p = subprocess.run(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        s = parse_stats(stats)
+        if "inst" not in s or s["inst"][0] == 0:
+            print(f"[WARN] interval {idx}: no statistics (rc={p.returncode}), skipped", file=sys.stderr)
+            continue
+        inst, cycle = s["inst"]
+        cf, cf_cor = s.get("cf", (0,))[0], s.get("cf_cor", (0,))[0]
+        # weighting CPI, not IPC, keeps the estimate equal to total cycles / total insts
+        cpi += w * cycle / inst
+        wsum += w
+        # branch counts are scaled to per-instruction rates so each interval
+        # contributes in proportion to its weight, not its length
+        for key, (tot, cor) in (("cf", (cf, cf_cor)), ("b", s.get("b", (0, 0))), ("jalr", s.get("jalr", (0, 0)))):
+            acc[key][0] += w * tot / inst
+            acc[key][1] += w * cor / inst
+        rate = f"{cf_cor * 100.0 / cf:.2f}" if cf else "N/A"
+        print(f"{idx:>9} {w:>8.4f} {inst / cycle:>7.4f} {rate:>7}")
+
+    if wsum == 0:
+        sys.exit("[ERROR] no simpoint finished")
+    print("==================== SimPoint estimate ====================")
+    print(f"[IPC ] {wsum / cpi:.4f}  (weight covered {wsum:.4f})")
+    for key, name in (("cf", "ALL "), ("b", "B   "), ("jalr", "JALR")):
+        tot, cor = acc[key]
+        print(f"[{name}] {cor * 100.0 / tot:.2f}%" if tot > 0 else f"[{name}] N/A")
+    return 0
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("profile", help="write basic-block vectors from the NEMU reference")
+    p.add_argument("--sim", required=True, help="simulator binary")
+    p.add_argument("--diff", required=True, help="NEMU reference .so")
+    p.add_argument("--image", required=True)
+    p.add_argument("--interval", type=int, default=1000000)
+    p.add_argument("-o", "--output", required=True)
+    p.add_argument("-q", "--quiet", action="store_true")
+    p.set_defaults(func=cmd_profile)
+
+    p = sub.add_parser("cluster", help="choose simpoints and weights from a .bb file")
+    p.add_argument("bbv")
+    p.add_argument("-k", type=int, default=10, help="number of clusters (default 10)")
+    p.add_argument("--restarts", type=int, default=5)
+    p.add_argument("--seed", type=int, default=1)
+    p.add_argument("-o", "--output", required=True)
+    p.set_defaults(func=cmd_cluster)
+
+    p = sub.add_parser("run", help="simulate the simpoints in RTL and combine the results")
+    p.add_argument("--sim", required=True, help="simulator binary (release/pgo build recommended)")
+    p.add_argument("--diff", required=True, help="NEMU reference .so, used for fast-forward")
+    p.add_argument("--image", required=True)
+    p.add_argument("--interval", type=int, default=1000000, help="must match the profile")
+    p.add_argument("--warmup", type=int, default=100000, help="instructions run in RTL before each interval")
+    p.add_argument("simpoints")
+    p.add_argument("extra", nargs="*", help="extra simulator arguments (after --)")
+    p.set_defaults(func=cmd_run)
+
+    args = ap.parse_args()
+    return args.func(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
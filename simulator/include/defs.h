@@ -17,7 +17,9 @@ void 		cpu_exec(uint64_t n);
 
 // sim control (sim.c)
 void        sim_set_quit_on_limit(int en);
-void        sim_set_pcpred_report_interval(uint64_t interval);
+void        sim_set_fast_mode(int en);
+void        sim_begin_measurement();
+void        sdb_set_batch_warmup(uint64_t n);
 
 //cpu.c
 
@@ -51,6 +53,7 @@ void		init_rand();
 word_t 		get_expr_val(char *args, bool *success);
 void 		wp_print();
 void 		wp_check_and_update();
+bool 		wp_enabled();
 void 		wp_del_watched(int num);
 void 		wp_add_watched(char *expr);
 void 		wp_init();
@@ -66,6 +69,7 @@ void 		get_memory_val(paddr_t mem_addr, int length);
 static 		word_t arg2val(char *arg);
 
 //npc-dpi
+uint64_t dpi_store_count();
 
 
 
@@ -74,7 +78,16 @@ void 		init_disasm(const char *triple);
 void 		disassemble(char *str, int size, uint64_t pc, uint8_t *code, int nbyte);
 
 
-void difftest_step(vaddr_t pc, vaddr_t npc);
+void difftest_step(vaddr_t pc, vaddr_t npc, uint32_t instr);
+void difftest_set_batch(uint64_t k);
+void difftest_set_mem_interval(uint64_t n);
+void difftest_mem_baseline(paddr_t page);
+void difftest_check_mem(const char *when);
+bool difftest_enabled();
+void difftest_fast_forward(uint64_t n);
+void difftest_detach();
+void difftest_sync();
+void difftest_profile_bbv(const char *file, uint64_t interval);
 bool isa_difftest_checkregs(CPU_state *ref_r, vaddr_t pc);
 
 
@@ -83,20 +96,96 @@ uint64_t get_time();
 //npc.c
 void npc_open_simulation();
 void npc_close_simulation();
+void npc_set_wave(const char *file, uint64_t start, uint64_t end, int cycle_unit);
+void npc_wave_ctl(int mode);
 void update_cpu_state();
 void npc_single_cycle();
 void npc_reset(int n);
 void npc_init();
 void npc_exec_once();
 void npc_get_clk_count();
+uint64_t npc_cycle_count();
+void npc_load_arch_state(const CPU_state *s);
+void npc_set_reset_state(vaddr_t pc, const word_t *csr);
 
 //memory.c
 void 	 init_mem();
 uint8_t* guest_to_host(paddr_t paddr);
 word_t	 pmem_read(paddr_t addr, int len);
 void	 pmem_write(paddr_t addr, int len, word_t data);
-
-
-void     instr_trace(word_t pc);
+void	 pmem_mark_written(paddr_t addr, size_t len);
+void	 pmem_map_file(paddr_t addr, int fd, off_t off, size_t len);
+void	 pmem_set_write_hook(void (*hook)(paddr_t addr, int len, word_t old));
+bool	 pmem_page_written(uint32_t page);
+const uint32_t *pmem_dirty_pages(size_t *n);
+void	 pmem_clear_dirty();
+
+//elf.c
+typedef struct {
+  vaddr_t     addr;
+  word_t      size;   // 0: unknown, up to the next symbol
+  const char *name;
+} Symbol;
+long          load_elf(const char *file, bool load);
+const Symbol *symbol_lookup(vaddr_t pc);
+size_t        symbol_count();
+const Symbol *symbol_table();
+
+//stats.c
+void     stat_scalar(const char *name, uint64_t *counter, const char *desc);
+void     stat_hist(const char *name, uint64_t *bucket, int n, const char *const *label, const char *desc);
+void     stat_ratio(const char *name, const char *num, const char *den, double scale, const char *desc);
+void     stat_diff(const char *name, const char *a, const char *b, const char *desc);
+void     stats_set_interval(uint64_t n);
+uint64_t stats_interval();
+void     stats_open(const char *file);
+void     stats_begin();
+void     stats_window();
+void     stats_dump();
+
+//checkpoint.c
+extern NPC_LOCAL uint64_t g_checkpoint_at;
+void     checkpoint_set_save(const char *arg);
+void     checkpoint_save();
+void     checkpoint_restore(const char *file);
+class VerilatedSerialize;
+class VerilatedDeserialize;
+void     npc_serialize(VerilatedSerialize &os);
+void     npc_deserialize(VerilatedDeserialize &is);
+void     stats_serialize(VerilatedSerialize &os);
+void     stats_deserialize(VerilatedDeserialize &is);
+
+//wave_ring.c
+extern NPC_LOCAL bool g_wave_ring_on;
+void     wave_ring_init(uint64_t k);
+void     wave_ring_cycle(uint64_t clk);
+void     wave_ring_dump(const char *why);
+bool     wave_ring_request(const char *why);
+bool     wave_ring_replaying();
+uint64_t wave_ring_depth();
+
+
+void     instr_trace(word_t pc, uint32_t instr);
+void     itrace_disable();
+bool     itrace_enabled();
+void     iringbuf_dump();
+void     iringbuf_dump_at(uint64_t mark);
+
+//func_trace.c
+bool     ftrace_enabled();
+void     ftrace_open(const char *file);
+void     ftrace_commit(vaddr_t pc, uint32_t instr, vaddr_t next_pc, vaddr_t pred_pc);
+void     ftrace_dump();
+
+//pc_hist.c
+bool     pc_hist_enabled();
+void     pc_hist_open(const char *file);
+void     pc_hist_commit(vaddr_t pc, uint32_t instr, vaddr_t next_pc, vaddr_t pred_pc);
+void     pc_hist_dump();
+
+//commit_log.c
+void     commit_log_open(const char *file);
+bool     commit_log_enabled();
+void     commit_log_record(word_t pc, uint32_t instr, word_t next_pc, word_t pred_pc, const word_t *gpr);
 
 #endif
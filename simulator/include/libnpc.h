@@ -0,0 +1,34 @@
+#ifndef __LIBNPC_H__
+#define __LIBNPC_H__
+// libnpc: the simulator as a library (make lib -> build/lib/libnpc.a, libnpc.so).
+// An instance is one simulator run with its own command line, the options and
+// IMAGE of build/*/CPU, always in batch mode. It owns its model and
+// VerilatedContext, pmem, DiffTest reference, logs and statistics, and runs on
+// a thread of its own, so any number of instances can run at the same time.
+// Images are mapped copy-on-write: instances of the same image share the
+// pages they do not store to.
+//
+// Link: libnpc.a libverilated.a -lreadline -lhistory -ldl -pthread $(llvm-config --libs)
+//
+// Limits: the DiffTest reference is loaded into a link-map namespace per
+// instance (dlmopen), glibc has 16, so at most 15 instances can run --diff at
+// the same time. Options and image paths are copied, output files (--log,
+// --stats, ...) must differ between instances that run together.
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct LibNpc LibNpc;
+
+// Starts an instance, argv[0] is the program name as for main().
+LibNpc *libnpc_start(int argc, char **argv);
+// Waits for the instance to end and frees it. 0: HIT GOOD TRAP or the
+// --max-commit limit, 1: anything else (bad trap, DiffTest mismatch, error).
+int     libnpc_wait(LibNpc *npc);
+// libnpc_start() + libnpc_wait()
+int     libnpc_run(int argc, char **argv);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
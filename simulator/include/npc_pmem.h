@@ -0,0 +1,18 @@
+#ifndef __NPC_PMEM_H__
+#define __NPC_PMEM_H__
+// Force-included into every translation unit, the Verilated model too
+// (-include in the Makefile): fetch_stage.v and ram.v read guest memory with
+// $c32("NPC_PMEM_READ32(", addr, ")") instead of calling dpi_mem_read().
+// The RTL only uses it when all 4 bytes are inside pmem, under the same
+// condition that would otherwise select the DPI call.
+#include <stdint.h>
+#include <autoconf.h>
+
+#ifdef NPC_LIB
+extern thread_local uint8_t *npc_pmem;   // one pmem per libnpc instance
+#else
+extern uint8_t *npc_pmem;
+#endif
+#define NPC_PMEM_READ32(addr) (*(const uint32_t *)(npc_pmem + ((uint32_t)(addr) - CONFIG_MBASE)))
+
+#endif
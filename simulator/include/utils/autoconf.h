@@ -14,6 +14,8 @@
 #define CONFIG_MBASE 0x80000000
 #define CONFIG_SERIAL_MMIO 0xa00003f8
 #define CONFIG_ITRACE_COND "true"
+#define CONFIG_IRINGBUF_SIZE 64
 #define CONFIG_TRACE_START 0
 #define CONFIG_TRACE 1
+#define CONFIG_FUNC_TRACE 1
 #define CONFIG_PMEM_GARRAY 1
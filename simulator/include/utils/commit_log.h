@@ -0,0 +1,101 @@
+#ifndef __COMMIT_LOG_H__
+#define __COMMIT_LOG_H__
+// Binary commit log (--commit-log=FILE), shared by the simulator and
+// tools/npc-tracetool.cc, so this header only depends on the C library.
+//
+// File:   "NPCCLOG1" then one record per commit.
+// Record: flags byte, then the fields it selects, varints are LEB128:
+//   COMMIT_LOG_PC     zigzag(pc - previous record's next_pc), omitted when 0
+//   (always)          instr, 4 bytes little endian
+//   COMMIT_LOG_RD     rd byte, zigzag(value - previous value written to rd)
+//   COMMIT_LOG_NEXT   zigzag(next_pc - (pc + 4)), omitted when 0
+//   COMMIT_LOG_PRED   zigzag(pred_pc - next_pc), omitted when the prediction is correct
+// A straight-line ALU instruction is 6-7 bytes, a correctly predicted branch 5-6.
+#include <stdint.h>
+#include <stddef.h>
+
+#define COMMIT_LOG_MAGIC "NPCCLOG1"
+#define COMMIT_LOG_PC    0x01
+#define COMMIT_LOG_RD    0x02
+#define COMMIT_LOG_NEXT  0x04
+#define COMMIT_LOG_PRED  0x08
+
+typedef struct {
+  uint32_t pc, instr;
+  uint32_t rd, value;   // rd == 0: no register written
+  uint32_t next_pc;     // resolved next pc (commit_pre_pc)
+  uint32_t pred_pc;     // predicted next pc (commit_pred_pc)
+} CommitRecord;
+
+// Encoder/decoder state: fields are stored relative to it.
+typedef struct {
+  uint32_t next_pc;
+  uint32_t gpr[32];
+} CommitLogState;
+
+static inline uint32_t commit_log_zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+static inline int32_t  commit_log_unzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+static inline uint8_t *commit_log_put_varint(uint8_t *p, uint32_t v) {
+  while (v >= 0x80) { *p++ = (uint8_t)(v | 0x80); v >>= 7; }
+  *p++ = (uint8_t)v;
+  return p;
+}
+static inline const uint8_t *commit_log_get_varint(const uint8_t *p, const uint8_t *end, uint32_t *v) {
+  uint32_t r = 0;
+  for (int shift = 0; p < end && shift < 35; shift += 7) {
+    uint8_t b = *p++;
+    r |= (uint32_t)(b & 0x7f) << shift;
+    if (!(b & 0x80)) { *v = r; return p; }
+  }
+  return NULL;
+}
+
+// At most 1 + 5 + 4 + 1 + 5 + 5 + 5 bytes.
+#define COMMIT_LOG_MAX_RECORD 26
+
+static inline uint8_t *commit_log_encode(CommitLogState *s, const CommitRecord *r, uint8_t *p) {
+  uint8_t *flags = p++;
+  uint8_t f = 0;
+  if (r->pc != s->next_pc) { f |= COMMIT_LOG_PC; p = commit_log_put_varint(p, commit_log_zigzag((int32_t)(r->pc - s->next_pc))); }
+  for (int i = 0; i < 4; i ++) *p++ = (uint8_t)(r->instr >> (8 * i));
+  if (r->rd != 0) {
+    f |= COMMIT_LOG_RD;
+    *p++ = (uint8_t)r->rd;
+    p = commit_log_put_varint(p, commit_log_zigzag((int32_t)(r->value - s->gpr[r->rd])));
+    s->gpr[r->rd] = r->value;
+  }
+  if (r->next_pc != r->pc + 4) { f |= COMMIT_LOG_NEXT; p = commit_log_put_varint(p, commit_log_zigzag((int32_t)(r->next_pc - r->pc - 4))); }
+  if (r->pred_pc != r->next_pc) { f |= COMMIT_LOG_PRED; p = commit_log_put_varint(p, commit_log_zigzag((int32_t)(r->pred_pc - r->next_pc))); }
+  *flags = f;
+  s->next_pc = r->next_pc;
+  return p;
+}
+
+// Returns the end of the record, or NULL if it is truncated or malformed.
+static inline const uint8_t *commit_log_decode(CommitLogState *s, const uint8_t *p, const uint8_t *end, CommitRecord *r) {
+  uint32_t v;
+  if (p >= end) return NULL;
+  uint8_t f = *p++;
+  r->pc = s->next_pc;
+  if (f & COMMIT_LOG_PC) { if (!(p = commit_log_get_varint(p, end, &v))) return NULL; r->pc += commit_log_unzigzag(v); }
+  if (end - p < 4) return NULL;
+  r->instr = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+  p += 4;
+  r->rd = 0; r->value = 0;
+  if (f & COMMIT_LOG_RD) {
+    if (p >= end || *p >= 32) return NULL;
+    r->rd = *p++;
+    if (!(p = commit_log_get_varint(p, end, &v))) return NULL;
+    r->value = s->gpr[r->rd] + commit_log_unzigzag(v);
+    s->gpr[r->rd] = r->value;
+  }
+  r->next_pc = r->pc + 4;
+  if (f & COMMIT_LOG_NEXT) { if (!(p = commit_log_get_varint(p, end, &v))) return NULL; r->next_pc += commit_log_unzigzag(v); }
+  r->pred_pc = r->next_pc;
+  if (f & COMMIT_LOG_PRED) { if (!(p = commit_log_get_varint(p, end, &v))) return NULL; r->pred_pc += commit_log_unzigzag(v); }
+  s->next_pc = r->next_pc;
+  return p;
+}
+
+#endif
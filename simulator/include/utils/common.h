@@ -26,6 +26,8 @@ typedef word_t   paddr_t;
 #define PMEM_LEFT  ((paddr_t)CONFIG_MBASE)
 #define PMEM_RIGHT ((paddr_t)CONFIG_MBASE + CONFIG_MSIZE - 1)
 #define RESET_VECTOR (PMEM_LEFT + CONFIG_PC_RESET_OFFSET)
+#define PMEM_PAGE_SIZE 4096
+#define PMEM_NR_PAGES  (CONFIG_MSIZE / PMEM_PAGE_SIZE)
 
 //gpr && csr
 #define GPR_NUM 32
@@ -5,6 +5,7 @@
 #include <macro.h>
 #include <utils.h>
 #include <assert.h>
+#include <stdlib.h>
 
 #define Log(format, ...) \
     _Log(ANSI_FMT("[%s:%d %s] " format, ANSI_FG_BLUE) "\n", __FILE__, __LINE__, __func__, ## __VA_ARGS__)
@@ -14,11 +15,22 @@
     if (!(cond)) { \
       MUXDEF(CONFIG_TARGET_AM, printf(ANSI_FMT(format, ANSI_FG_RED) "\n", ## __VA_ARGS__), \
         (fflush(stdout), fprintf(stderr, ANSI_FMT(format, ANSI_FG_RED) "\n", ##  __VA_ARGS__))); \
-      IFNDEF(CONFIG_TARGET_AM, extern FILE* log_fp; fflush(log_fp)); \
+      IFNDEF(CONFIG_TARGET_AM, extern NPC_LOCAL FILE* log_fp; fflush(log_fp)); \
+      IFDEF(NPC_LIB, npc_exit(1)); \
       assert(cond); \
     } \
   } while (0)
 
+// libnpc: an error ends only its own instance, npc_exit() unwinds to the
+// instance thread and the npc_atexit() functions run there (src/lib/libnpc.c)
+#ifdef NPC_LIB
+[[noreturn]] void npc_exit(int status);
+void npc_atexit(void (*fn)());
+#else
+#define npc_exit(status) exit(status)
+#define npc_atexit(fn)   atexit(fn)
+#endif
+
 #define panic(format, ...) Assert(0, format, ## __VA_ARGS__)
 #define TODO() panic("please implement me")
 
@@ -0,0 +1,51 @@
+#ifndef __HOST_PROF_H__
+#define __HOST_PROF_H__
+// Host-side phase profiler (--host-profile). HOST_PHASE(p) charges the rest
+// of the enclosing scope to phase p, measured with the TSC. A phase nested in
+// another (a DPI call inside dut.eval()) is subtracted from the outer one, so
+// every tick goes to exactly one phase. Off, it costs one predicted branch.
+#include <stdint.h>
+#include <macro.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t host_tsc() { return __rdtsc(); }
+#else
+#include <time.h>
+static inline uint64_t host_tsc() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+#endif
+
+// HOST_HARNESS: the rest of cpu_exec (commit loop, statistics, profilers)
+enum { HOST_EVAL, HOST_DPI_MEM, HOST_CPU_STATE, HOST_DIFFTEST, HOST_ITRACE, HOST_WAVE, HOST_HARNESS, NR_HOST_PHASE };
+extern const char *const host_phase_name[NR_HOST_PHASE];
+extern NPC_LOCAL bool     g_host_prof;
+extern NPC_LOCAL uint64_t g_host_tsc[NR_HOST_PHASE];
+extern NPC_LOCAL uint64_t g_host_nested;   // ticks of the phases nested in the current one
+
+struct HostPhase {
+  int phase;
+  uint64_t start, outer;
+  explicit HostPhase(int p) : phase(p), start(0), outer(0) {
+    if (__builtin_expect(g_host_prof, 0)) {
+      outer = g_host_nested;
+      g_host_nested = 0;
+      start = host_tsc();
+    }
+  }
+  ~HostPhase() {
+    if (__builtin_expect(g_host_prof, 0)) {
+      const uint64_t t = host_tsc() - start;
+      g_host_tsc[phase] += t - g_host_nested;
+      g_host_nested = outer + t;
+    }
+  }
+};
+#define HOST_PHASE(p) HostPhase host_phase_scope(p)
+
+void host_prof_enable();
+void host_prof_dump(uint64_t host_us);
+
+#endif
@@ -81,6 +81,14 @@
 
 #define PG_ALIGN __attribute((aligned(4096)))
 
+// state of one simulator instance: thread_local in libnpc (NPC_LIB), where
+// every instance runs on a thread of its own, a plain global in the CPU binary
+#ifdef NPC_LIB
+#define NPC_LOCAL thread_local
+#else
+#define NPC_LOCAL
+#endif
+
 #if !defined(likely)
 #define likely(cond)   __builtin_expect(cond, 1)//MUXDEF
 
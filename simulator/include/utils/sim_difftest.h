@@ -12,3 +12,7 @@
 
 #define CONFIG_NPC_OPEN_SIM 1
 
+// release/pgo 构建不带 --trace (VM_TRACE=0)，此时没有波形接口，强制关闭波形追踪
+#if defined(VM_TRACE) && !VM_TRACE
+#undef CONFIG_NPC_OPEN_SIM
+#endif
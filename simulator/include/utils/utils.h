@@ -23,7 +23,7 @@
 
 #define log_write(...) IFDEF(CONFIG_TARGET_NATIVE_ELF, \
   do { \
-    extern FILE* log_fp; \
+    extern NPC_LOCAL FILE* log_fp; \
     extern bool log_enable(); \
     if (log_enable()) { \
       fprintf(log_fp, __VA_ARGS__); \
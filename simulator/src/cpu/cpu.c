@@ -3,8 +3,8 @@
 #include <defs.h>
 #include <cpu.h>
 
-CPU_state cpu; 
-uint32_t *reg_ptr = NULL;
+NPC_LOCAL CPU_state cpu; 
+NPC_LOCAL uint32_t *reg_ptr = NULL;
 
 const char *regs[] = {
   "$0", "ra", "sp",  "gp",  "tp", "t0", "t1", "t2",
@@ -33,6 +33,7 @@ const char* reg_name(int idx) {
 
 //打印寄存器的值
 void   isa_reg_display(){
+  update_cpu_state();
   printf(" name       DEC         HEX\n");
   for(int i = 0; i < 32; ++i){
     printf("%3s    %-10u  %#-10x\n",reg_name(i), gpr(i), gpr(i));
@@ -41,6 +42,7 @@ void   isa_reg_display(){
 
 //
 word_t get_reg_val(const char *s, bool *success) {
+  update_cpu_state();
   if(strcmp(s, "pc")  == 0 || strcmp(s, "PC") == 0){
     *success = true;
     return cpu.pc;
@@ -0,0 +1,86 @@
+#include <common.h>
+#include <defs.h>
+#include <debug.h>
+#include <unordered_map>
+
+// Basic-block vector profiling in the DiffTest reference (NEMU), for SimPoint.
+// Output is the SimPoint .bb format, one line per interval:
+//   T:<bb id>:<instructions executed in that block> :<bb id>:<count> ...
+// Block ids start at 1 and are assigned in order of first execution.
+#ifdef CONFIG_DIFFTEST
+extern NPC_LOCAL void (*ref_difftest_regcpy)(void *dut, bool direction);
+extern NPC_LOCAL void (*ref_difftest_exec)(uint64_t n);
+
+#define INST_EBREAK 0x00100073
+
+static bool ends_basic_block(uint32_t instr) {
+  switch (instr & 0x7f) {
+    case 0x63: // B
+    case 0x6f: // JAL
+    case 0x67: // JALR
+    case 0x73: // SYSTEM (ecall/mret)
+      return true;
+    default:
+      return false;
+  }
+}
+
+void difftest_profile_bbv(const char *file, uint64_t interval) {
+  Assert(difftest_enabled(), "--bbv needs the NEMU reference (--diff)");
+  Assert(interval > 0, "--bbv-interval must be positive");
+  FILE *fp = fopen(file, "w");
+  Assert(fp, "Can not open '%s'", file);
+
+  std::unordered_map<vaddr_t, uint32_t> bb_id;      // block start pc -> id
+  std::unordered_map<uint32_t, uint64_t> bb_count;  // id -> count in this interval
+  auto flush_block = [&](vaddr_t start, uint64_t len) {
+    if (len == 0) return;
+    auto it = bb_id.find(start);
+    uint32_t id = (it != bb_id.end()) ? it->second : (bb_id[start] = bb_id.size() + 1);
+    bb_count[id] += len;
+  };
+  uint64_t nr_interval = 0;
+  auto flush_interval = [&]() {
+    fprintf(fp, "T");
+    for (auto &kv : bb_count) fprintf(fp, ":%u:%" PRIu64 " ", kv.first, kv.second);
+    fprintf(fp, "\n");
+    bb_count.clear();
+    nr_interval ++;
+  };
+
+  uint64_t start_time = get_time();
+  CPU_state ref_r;
+  ref_difftest_regcpy(&ref_r, DIFFTEST_TO_DUT);
+  vaddr_t pc = ref_r.pc, bb_start = pc;
+  uint64_t bb_len = 0, nr_inst = 0;
+  for (;;) {
+    // code is not self-modifying, so the DUT copy of the image is good enough to decode
+    uint32_t instr = pmem_read(pc, 4);
+    bb_len ++;
+    nr_inst ++;
+    if (instr == INST_EBREAK) break;
+    ref_difftest_exec(1);
+    ref_difftest_regcpy(&ref_r, DIFFTEST_TO_DUT);
+    if (ends_basic_block(instr)) {
+      flush_block(bb_start, bb_len);
+      bb_start = ref_r.pc;
+      bb_len = 0;
+    }
+    pc = ref_r.pc;
+    if (nr_inst % interval == 0) {
+      // a block cut by the interval boundary continues under the same id
+      flush_block(bb_start, bb_len);
+      bb_len = 0;
+      flush_interval();
+    }
+  }
+  flush_block(bb_start, bb_len);
+  if (!bb_count.empty()) flush_interval();
+  fclose(fp);
+  Log("BBV profile: %" PRIu64 " instructions, %" PRIu64 " intervals of %" PRIu64
+      ", %zu basic blocks, %" PRIu64 " us -> %s",
+      nr_inst, nr_interval, interval, bb_id.size(), get_time() - start_time, file);
+}
+#else
+void difftest_profile_bbv(const char *file, uint64_t interval) { panic("--bbv needs CONFIG_DIFFTEST"); }
+#endif
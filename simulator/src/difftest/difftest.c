@@ -6,28 +6,304 @@
 #include <defs.h>
 #include <debug.h>
 #include <cpu.h>
+#include <host_prof.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <unistd.h>
 
 
-void (*ref_difftest_memcpy)(paddr_t addr, void *buf, size_t n, bool direction) = NULL;
-void (*ref_difftest_regcpy)(void *dut, bool direction) = NULL;
-void (*ref_difftest_exec)(uint64_t n) = NULL;
-void (*ref_difftest_raise_intr)(uint64_t NO) = NULL;
+NPC_LOCAL void (*ref_difftest_memcpy)(paddr_t addr, void *buf, size_t n, bool direction) = NULL;
+NPC_LOCAL void (*ref_difftest_regcpy)(void *dut, bool direction) = NULL;
+NPC_LOCAL void (*ref_difftest_exec)(uint64_t n) = NULL;
+NPC_LOCAL void (*ref_difftest_raise_intr)(uint64_t NO) = NULL;
 #ifdef CONFIG_DIFFTEST
-extern CPU_state cpu;
-extern SIMState sim_state;
+extern NPC_LOCAL CPU_state cpu;
+extern NPC_LOCAL SIMState sim_state;
+extern NPC_LOCAL uint64_t g_nr_guest_inst;
+
+static NPC_LOCAL bool difftest_inited = false;
+static NPC_LOCAL bool is_skip_ref = false;
+static NPC_LOCAL void *ref_handle = NULL;
+bool difftest_enabled() { return difftest_inited; }
+
+// 异步 DiffTest：RTL 线程每提交一条指令就往 SPSC 队列里放一条记录 (pc, 下一条 pc,
+// GPR, 是否 skip_ref)，checker 线程单步 NEMU 并比较。出错时 checker 只记下出错的
+// 记录和 REF 状态，由 RTL 线程在下一次提交 (或 difftest_sync) 时报错退出，因为
+// 关波形、dump itrace 都要在模型所在的线程里做。
+// NEMU 只在 checker 线程里调用；RTL 线程要直接访问 REF (checkpoint、fast-forward、
+// skip_dut) 之前先 difftest_sync() 等队列清空。
+// 两个线程共享的状态都在 DiffQueue 里 (init_difftest 分配)，其余的变量是 NPC_LOCAL 的，
+// libnpc 里 checker 线程启动时从 RTL 线程拷一份。
+typedef struct {
+  uint64_t seq;       // g_nr_guest_inst, for iringbuf_dump_at()
+  uint64_t clk;
+  vaddr_t pc;
+  vaddr_t next_pc;
+  uint32_t instr;
+  bool    skip_ref;   // MMIO: REF 不执行这条指令，直接拷贝 DUT 的状态
+  word_t  gpr[32];
+} DiffRecord;
+
+#define DIFF_QUEUE_SIZE 4096  // power of 2
+typedef struct {
+  DiffRecord rec[DIFF_QUEUE_SIZE];
+  alignas(64) std::atomic<uint64_t> head{0};     // written by the RTL thread
+  alignas(64) std::atomic<uint64_t> tail{0};     // written by the checker thread
+  alignas(64) std::atomic<uint64_t> checked{0};  // records compared so far (<= tail in batch mode)
+  std::atomic<bool> flush_req{false};            // difftest_sync() wants the open batch checked
+  alignas(64) std::atomic<bool> failed{false};
+  std::atomic<bool> stop{false};
+  DiffRecord failed_rec;
+  CPU_state  failed_ref;
+  const char *failed_msg = NULL;
+  int skip_dut_nr_inst = 0;  // only touched by the checker thread, or after difftest_sync()
+} DiffQueue;
+static NPC_LOCAL DiffQueue *dq = NULL;
+static NPC_LOCAL std::thread checker;
+static NPC_LOCAL uint64_t nr_commit_store = 0;     // committed S-type instructions
+static NPC_LOCAL uint64_t mem_check_interval = 1000000;
+static NPC_LOCAL uint64_t mem_check_next = 1000000;
+// How many commits the RTL may run ahead of the checker. A failure is reported
+// that late, and the itrace ring must still hold the bad commit: half of it
+// (the other half is context), or a whole --diff-batch, at most the queue.
+static NPC_LOCAL uint64_t max_lag = DIFF_QUEUE_SIZE;
+
+// spin first, then back off so an idle checker (sdb prompt) does not burn a core
+static inline void cpu_relax(unsigned &spins) {
+  if (++ spins < 1024) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  }
+  else if (spins < 65536) std::this_thread::yield();
+  else usleep(50);
+}
 
-static bool difftest_inited = false;
-static bool is_skip_ref = false;
-static int skip_dut_nr_inst = 0;
 void difftest_skip_ref() {
   if (!difftest_inited) return;
   is_skip_ref = true;
-  skip_dut_nr_inst = 0;
+}
+
+static bool check_record(const DiffRecord *r, CPU_state *ref) {
+  if (ref->pc != r->next_pc) return false;
+  for (int i = 0; i < 32; i ++) {
+    if (ref->gpr[i] != r->gpr[i]) return false;
+  }
+  return true;
+}
+
+static void checker_fail(const DiffRecord *r, const CPU_state *ref, const char *msg) {
+  dq->failed_rec = *r;
+  dq->failed_ref = *ref;
+  dq->failed_msg = msg;
+  dq->failed.store(true, std::memory_order_release);
+}
+
+// one commit on the checker side, same rules as the old synchronous difftest_step()
+static bool checker_step(const DiffRecord *r) {
+  CPU_state ref_r;
+  if (r->skip_ref) dq->skip_dut_nr_inst = 0;
+  if (dq->skip_dut_nr_inst > 0) {
+    ref_difftest_regcpy(&ref_r, DIFFTEST_TO_DUT);
+    if (ref_r.pc == r->next_pc) {
+      dq->skip_dut_nr_inst = 0;
+      if (!check_record(r, &ref_r)) { checker_fail(r, &ref_r, NULL); return false; }
+      return true;
+    }
+    if (-- dq->skip_dut_nr_inst == 0) { checker_fail(r, &ref_r, "can not catch up with ref.pc"); return false; }
+    return true;
+  }
+  if (r->skip_ref) {
+    ref_difftest_regcpy(&ref_r, DIFFTEST_TO_DUT);   // keep the REF CSRs
+    ref_r.pc = r->next_pc;
+    memcpy(ref_r.gpr, r->gpr, sizeof(r->gpr));
+    ref_difftest_regcpy(&ref_r, DIFFTEST_TO_REF);
+    return true;
+  }
+  ref_difftest_exec(1);
+  ref_difftest_regcpy(&ref_r, DIFFTEST_TO_DUT);
+  if (!check_record(r, &ref_r)) { checker_fail(r, &ref_r, NULL); return false; }
+  return true;
+}
+
+// --diff-batch=K: NEMU runs K commits with one exec(K), and only a 64-bit hash
+// of pc + GPRs is compared at the end of the batch. On a mismatch the REF is
+// rolled back to the start of the batch and the batch is re-run one commit at
+// a time against the recorded DUT states, which finds the first bad commit.
+// REF memory is rolled back by saving, before exec(K), the bytes each store in
+// the batch will overwrite; the store address is computed from the DUT
+// registers, which match the REF until the first divergence.
+static NPC_LOCAL uint64_t diff_batch = 0;   // 0: compare every commit
+static NPC_LOCAL std::vector<DiffRecord> batch;   // checker thread only
+
+void difftest_set_batch(uint64_t k) { diff_batch = k; }
+
+static inline uint64_t state_hash(vaddr_t pc, const word_t *gpr) {
+  uint64_t h = 0x9e3779b97f4a7c15ull ^ pc;
+  for (int i = 0; i < 32; i ++) {
+    h = (h ^ gpr[i]) * 0xff51afd7ed558ccdull;
+    h ^= h >> 32;
+  }
+  return h;
+}
+
+typedef struct { paddr_t addr; int len; word_t old; } RefUndo;
+
+static bool batch_check() {
+  if (batch.empty()) return true;
+  CPU_state start, ref_r;
+  ref_difftest_regcpy(&start, DIFFTEST_TO_DUT);
+
+  static NPC_LOCAL std::vector<RefUndo> undo;
+  undo.clear();
+  for (size_t i = 0; i < batch.size(); i ++) {
+    const DiffRecord *r = &batch[i];
+    if ((r->instr & 0x7f) != 0x23) continue;   // S-type
+    const word_t *before = i ? batch[i - 1].gpr : start.gpr;
+    int32_t imm = ((int32_t)(r->instr & 0xfe000000) >> 20) | ((r->instr >> 7) & 0x1f);
+    RefUndo u = { (paddr_t)(before[(r->instr >> 15) & 0x1f] + imm), 1 << ((r->instr >> 12) & 0x3), 0 };
+    if (u.addr < CONFIG_MBASE || u.addr + u.len > CONFIG_MBASE + CONFIG_MSIZE) continue;  // MMIO
+    ref_difftest_memcpy(u.addr, &u.old, u.len, DIFFTEST_TO_DUT);
+    undo.push_back(u);
+  }
+
+  ref_difftest_exec(batch.size());
+  ref_difftest_regcpy(&ref_r, DIFFTEST_TO_DUT);
+  const DiffRecord *last = &batch.back();
+  if (state_hash(ref_r.pc, ref_r.gpr) == state_hash(last->next_pc, last->gpr)) {
+    dq->checked.fetch_add(batch.size(), std::memory_order_release);
+    batch.clear();
+    return true;
+  }
+
+  for (auto it = undo.rbegin(); it != undo.rend(); ++ it) ref_difftest_memcpy(it->addr, &it->old, it->len, DIFFTEST_TO_REF);
+  ref_difftest_regcpy(&start, DIFFTEST_TO_REF);
+  for (const DiffRecord &r : batch) {
+    ref_difftest_exec(1);
+    ref_difftest_regcpy(&ref_r, DIFFTEST_TO_DUT);
+    if (!check_record(&r, &ref_r)) { checker_fail(&r, &ref_r, NULL); return false; }
+  }
+  checker_fail(last, &ref_r, "batch hash mismatch not reproduced by single-stepping, ref.pc");
+  return false;
+}
+
+static void checker_main() {
+  uint64_t tail = dq->tail.load(std::memory_order_relaxed);
+  unsigned spins = 0;
+  while (!dq->stop.load(std::memory_order_relaxed)) {
+    if (tail == dq->head.load(std::memory_order_acquire)) {
+      if (!batch.empty() && dq->flush_req.load(std::memory_order_acquire)) {
+        if (!batch_check()) return;
+        continue;
+      }
+      cpu_relax(spins);
+      continue;
+    }
+    spins = 0;
+    const DiffRecord *r = &dq->rec[tail % DIFF_QUEUE_SIZE];
+    bool ok;
+    if (diff_batch == 0 || r->skip_ref || dq->skip_dut_nr_inst > 0) {
+      // MMIO and skip_dut need the commit-by-commit rules
+      ok = batch_check() && checker_step(r);
+      if (ok) dq->checked.fetch_add(1, std::memory_order_release);
+    } else {
+      batch.push_back(*r);
+      ok = (batch.size() < diff_batch) || batch_check();
+    }
+    dq->tail.store(++ tail, std::memory_order_release);
+    if (!ok) return;   // the RTL thread reports and exits
+  }
+}
+
+static void checker_join() {
+  if (!checker.joinable()) return;
+  dq->stop.store(true);
+  checker.join();
+}
+
+// registered with npc_atexit(): a libnpc instance also gives back the REF copy
+static void difftest_close() {
+  checker_join();
+  IFDEF(NPC_LIB, if (ref_handle) dlclose(ref_handle));
+  delete dq;
+  dq = NULL;
+}
+
+static void report_failure();
+
+static void wait_checked() {
+  const uint64_t head = dq->head.load(std::memory_order_relaxed);
+  unsigned spins = 0;
+  dq->flush_req.store(true, std::memory_order_release);
+  while (dq->checked.load(std::memory_order_acquire) != head) {
+    if (dq->failed.load(std::memory_order_acquire)) break;
+    cpu_relax(spins);
+  }
+  dq->flush_req.store(false, std::memory_order_release);
+}
+
+// Wait until the checker has compared every pushed commit.
+void difftest_sync() {
+  if (!difftest_inited) return;
+  wait_checked();
+  if (dq->failed.load(std::memory_order_acquire)) report_failure();
+}
+
+// Memory check: the DUT marks every page it stores to (pmem_write), and the
+// dirty pages are compared with the reference every mem_check_interval commits
+// and when the program ends. Pages that were not written are never looked at.
+void difftest_set_mem_interval(uint64_t n) { mem_check_interval = mem_check_next = n; }
+
+// First store to a page the reference has never seen: called from
+// pmem_write() inside a DPI call, so only wait for the checker, a failure is
+// reported at the next commit.
+void difftest_mem_baseline(paddr_t page) {
+  if (!difftest_inited) return;
+  wait_checked();
+  ref_difftest_memcpy(page, guest_to_host(page), PMEM_PAGE_SIZE, DIFFTEST_TO_REF);
+}
+
+void difftest_check_mem(const char *when) {
+  if (!difftest_inited) return;
+  // the RTL writes memory before the store commits; a store that is in the
+  // pipeline now has not been run by the reference yet
+  if (dpi_store_count() != nr_commit_store) {
+    Log("DiffTest memory check (%s) skipped: a store is still in the pipeline", when);
+    return;
+  }
+  difftest_sync();
+  static NPC_LOCAL uint8_t ref_page[PMEM_PAGE_SIZE];
+  size_t n;
+  const uint32_t *pages = pmem_dirty_pages(&n);
+  for (size_t i = 0; i < n; i ++) {
+    paddr_t addr = CONFIG_MBASE + pages[i] * PMEM_PAGE_SIZE;
+    const uint8_t *dut = guest_to_host(addr);
+    ref_difftest_memcpy(addr, ref_page, PMEM_PAGE_SIZE, DIFFTEST_TO_DUT);
+    if (memcmp(dut, ref_page, PMEM_PAGE_SIZE) == 0) continue;
+    int off = 0;
+    while (dut[off] == ref_page[off]) off ++;
+    printf("[NPC] Difftest Error: 内存不一致 (%s, %" PRIu64 " 条指令之后), 第一个不同的字节在 " FMT_PADDR ":\n",
+           when, dq->head.load(std::memory_order_relaxed), addr + off);
+    int from = off & ~0xf;
+    printf("[参考处理器] " FMT_PADDR ":", addr + from);
+    for (int j = from; j < from + 16; j ++) printf(" %02x", ref_page[j]);
+    printf("\n[你的处理器] " FMT_PADDR ":", addr + from);
+    for (int j = from; j < from + 16; j ++) printf(" %02x", dut[j]);
+    printf("\n");
+    iringbuf_dump();
+    wave_ring_dump("DiffTest memory mismatch");
+    checker_join();
+    npc_close_simulation();
+    npc_exit(1);
+  }
+  pmem_clear_dirty();
 }
 
 void difftest_skip_dut(int nr_ref, int nr_dut) {
   if (!difftest_inited) return;
-  skip_dut_nr_inst += nr_dut;
+  difftest_sync();
+  dq->skip_dut_nr_inst += nr_dut;
   while (nr_ref -- > 0) {
     ref_difftest_exec(1);
   }
@@ -39,9 +315,11 @@ void init_difftest(char *ref_so_file, long img_size, int port) {
     difftest_inited = false;
     return;
   }
-  void *handle;
-  handle = dlopen(ref_so_file, RTLD_LAZY);
-  assert(handle);
+  // libnpc: every instance needs its own REF, and dlopen() of the same file
+  // returns the loaded copy, so load it into a new link-map namespace
+  void *handle = MUXDEF(NPC_LIB, dlmopen(LM_ID_NEWLM, ref_so_file, RTLD_LAZY), dlopen(ref_so_file, RTLD_LAZY));
+  Assert(handle, "Can not load the DiffTest reference '%s': %s", ref_so_file, dlerror());
+  ref_handle = handle;
 
   ref_difftest_memcpy =  (void (*)(paddr_t, void *, size_t, bool))dlsym(handle, "difftest_memcpy");
   assert(ref_difftest_memcpy);
@@ -59,7 +337,9 @@ void init_difftest(char *ref_so_file, long img_size, int port) {
   assert(ref_difftest_init);
 
   ref_difftest_init(port); //do nothing
-  ref_difftest_memcpy(RESET_VECTOR, guest_to_host(RESET_VECTOR), img_size, DIFFTEST_TO_REF);
+  // whole pages: the tail of the last one is the DUT's random fill
+  ref_difftest_memcpy(RESET_VECTOR, guest_to_host(RESET_VECTOR), ROUNDUP(img_size, PMEM_PAGE_SIZE), DIFFTEST_TO_REF);
+  update_cpu_state();
   ref_difftest_regcpy(&cpu, DIFFTEST_TO_REF);  //cpu-->REF
 
   Log("Differential testing: %s", ANSI_FMT("ON", ANSI_FG_GREEN));
@@ -67,6 +347,21 @@ void init_difftest(char *ref_so_file, long img_size, int port) {
       "This will help you a lot for debugging, but also significantly reduce the performance. "
       "If it is not necessary, you can turn it off in menuconfig.", ref_so_file);
   difftest_inited = true;
+  max_lag = itrace_enabled() ? CONFIG_IRINGBUF_SIZE / 2 : DIFF_QUEUE_SIZE;
+  if (diff_batch > max_lag) max_lag = diff_batch;
+  if (max_lag > DIFF_QUEUE_SIZE) max_lag = DIFF_QUEUE_SIZE;
+  dq = new DiffQueue;
+#ifdef NPC_LIB
+  // a new thread starts with empty thread-locals: hand over the queue and the REF
+  checker = std::thread([q = dq, k = diff_batch, mc = ref_difftest_memcpy, rc = ref_difftest_regcpy,
+                         ex = ref_difftest_exec] {
+    dq = q; diff_batch = k; ref_difftest_memcpy = mc; ref_difftest_regcpy = rc; ref_difftest_exec = ex;
+    checker_main();
+  });
+#else
+  checker = std::thread(checker_main);
+#endif
+  npc_atexit(difftest_close);
 
 }
 
@@ -75,66 +370,154 @@ void init_difftest(char *ref_so_file, long img_size, int port) {
 
 
 
+static uint64_t page_hash(const uint8_t *page) {
+  uint64_t h = 0x9e3779b97f4a7c15ull;
+  for (size_t i = 0; i < PMEM_PAGE_SIZE; i += 8) {
+    uint64_t w;
+    memcpy(&w, page + i, 8);
+    h = (h ^ w) * 0xff51afd7ed558ccdull;
+    h ^= h >> 32;
+  }
+  return h;
+}
+
+// Run the first n instructions in NEMU only, then move its registers and the
+// memory pages it changed into the RTL. NEMU has no devices, so the skipped
+// region must not touch MMIO.
+// Only pages whose REF hash changed across exec(n) are copied: the rest of
+// NEMU's memory is its own random fill, which never matches the DUT's, and
+// copying it would touch (and checkpoint) every DUT page.
+void difftest_fast_forward(uint64_t n) {
+  Assert(difftest_inited, "--fast-forward needs the NEMU reference (--diff)");
+  difftest_sync();
+  uint64_t start = get_time();
+  static NPC_LOCAL uint8_t page[PMEM_PAGE_SIZE];
+  std::vector<uint64_t> before(PMEM_NR_PAGES);
+  for (uint32_t i = 0; i < PMEM_NR_PAGES; i ++) {
+    ref_difftest_memcpy(CONFIG_MBASE + i * PMEM_PAGE_SIZE, page, PMEM_PAGE_SIZE, DIFFTEST_TO_DUT);
+    before[i] = page_hash(page);
+  }
+  ref_difftest_exec(n);
+
+  uint32_t nr_page = 0;
+  for (uint32_t i = 0; i < PMEM_NR_PAGES; i ++) {
+    paddr_t addr = CONFIG_MBASE + i * PMEM_PAGE_SIZE;
+    ref_difftest_memcpy(addr, page, PMEM_PAGE_SIZE, DIFFTEST_TO_DUT);
+    if (page_hash(page) == before[i]) continue;
+    memcpy(guest_to_host(addr), page, PMEM_PAGE_SIZE);
+    pmem_mark_written(addr, PMEM_PAGE_SIZE);
+    nr_page ++;
+  }
+
+  CPU_state ref_r;
+  ref_difftest_regcpy(&ref_r, DIFFTEST_TO_DUT);
+  npc_load_arch_state(&ref_r);
+  Log("Fast-forwarded %" PRIu64 " instructions in NEMU (%" PRIu64 " us, %u pages changed), "
+      "RTL starts at pc = " FMT_WORD, n, get_time() - start, nr_page, ref_r.pc);
+}
+
+// Stop comparing against the reference (it is only used for fast-forward);
+// lets --fast count in RTL for SimPoint measurements.
+void difftest_detach() {
+  if (!difftest_inited) return;
+  difftest_sync();
+  checker_join();
+  difftest_inited = false;
+  Log("DiffTest detached");
+}
+
 //ref是参考处理器执行完对应指令后的数据
 //pc是执行指令的地址
-extern word_t commit_pre_pc;
-
-static void checkregs(CPU_state *ref, vaddr_t pc) {
-  //目前只对比
-  
-  if(commit_pre_pc != ref->pc){
-      printf("[NPC] Difftest Error: 在执行完pc=[%x]指令之后,DUT和REF的状态出现不一致:\n", pc);
-      printf("[参考处理器.pc]=0x%x\n[你的处理器.pc]=0x%x\n", ref->pc, commit_pre_pc);
+static void report_failure() {
+  const DiffRecord *r = &dq->failed_rec;
+  const CPU_state *ref = &dq->failed_ref;
+  checker_join();
+  if (dq->failed_msg) {
+    printf("[NPC] Difftest Error: %s = [%x] at pc = [%x]\n", dq->failed_msg, ref->pc, r->pc);
+  } else if (r->next_pc != ref->pc) {
+      printf("[NPC] Difftest Error: 在执行完pc=[%x]指令之后,DUT和REF的状态出现不一致:\n", r->pc);
+      printf("[参考处理器.pc]=0x%x\n[你的处理器.pc]=0x%x\n", ref->pc, r->next_pc);
       printf("\n-----------以下是所有寄存器数据：\n");
       for(int i = 0;  i < 32; ++i){
-        printf("[参考处理器.%s]=0x%x, [你的处理器.%s]=0x%x\n", reg_name(i), ref->gpr[i], reg_name(i), gpr(i));
+        printf("[参考处理器.%s]=0x%x, [你的处理器.%s]=0x%x\n", reg_name(i), ref->gpr[i], reg_name(i), r->gpr[i]);
+      }
+  } else {
+    for(int i = 0; i < 32; ++i){
+      if(ref->gpr[i] != r->gpr[i]){
+        printf("[NPC] Difftest Error: 在执行完pc=[%x]指令之后,DUT和REF状态出现不一致:\n", r->pc);
+        printf("[参考处理器.%s]=0x%x, [你的处理器.%s]=0x%x\n", reg_name(i), ref->gpr[i], reg_name(i), r->gpr[i]);
+        break;
       }
-      npc_close_simulation();
-      printf("下面将会产生一个makefile错误，暂时不用担心\n");
-      exit(1);
-  }
-
-  for(int i = 0; i < 32; ++i){
-    if(ref->gpr[i] != cpu.gpr[i]){  
-      printf("[NPC] Difftest Error: 在执行完pc=[%x]指令之后,DUT和REF状态出现不一致:\n", pc);
-      printf("[参考处理器.%s]=0x%x, [你的处理器.%s]=0x%x\n", reg_name(i), ref->gpr[i], reg_name(i), gpr(i));
-
-      npc_close_simulation();
-      printf("下面将会产生一个makefile错误，暂时不用担心\n");
-      exit(1);
-
     }
   }
+  printf("[NPC] 出错的是第 %" PRIu64 " 条提交的指令 (cycle %" PRIu64 "), 发现时已经提交到第 %" PRIu64 " 条\n",
+         r->seq, r->clk, g_nr_guest_inst);
+  iringbuf_dump_at(r->seq);
+  wave_ring_dump("DiffTest mismatch");
+  npc_close_simulation();
+  printf("下面将会产生一个makefile错误，暂时不用担心\n");
+  npc_exit(1);
 }
 
 
 //difftest_step
-void difftest_step(vaddr_t pc, vaddr_t next_pc) {
+extern NPC_LOCAL uint32_t *reg_ptr;
+
+// mcycle/minstret and mhpmcounter/mhpmevent differ from (or are missing in) the
+// REF, so a Zicsr access to them is skipped like MMIO
+static inline bool is_counter_csr(uint32_t instr) {
+  if ((instr & 0x7f) != 0x73 || ((instr >> 12) & 0x7) == 0) return false;
+  const uint32_t csr = instr >> 20;
+  return (csr & 0xf00) == 0xb00 || (csr & 0xf00) == 0xc00 || (csr >= 0x323 && csr < 0x340);
+}
+
+void difftest_step(vaddr_t pc, vaddr_t next_pc, uint32_t instr) {
   if (!difftest_inited) return;
-  CPU_state ref_r;
-  if (skip_dut_nr_inst > 0) {
-    ref_difftest_regcpy(&ref_r, DIFFTEST_TO_DUT);
-    if (ref_r.pc == next_pc) {
-      skip_dut_nr_inst = 0;
-      checkregs(&ref_r, next_pc);
-      return;
-    }
-    skip_dut_nr_inst --;
-    if (skip_dut_nr_inst == 0)
-      panic("can not catch up with ref.pc = " FMT_WORD " at pc = " FMT_WORD, ref_r.pc, pc);
-    return;
+  HOST_PHASE(HOST_DIFFTEST);
+  if (unlikely(dq->failed.load(std::memory_order_acquire))) report_failure();
+  const uint64_t head = dq->head.load(std::memory_order_relaxed);
+  // Keep the unchecked commits inside what the dumps at a failure can show:
+  // max_lag commits for itrace, and half the --wave-ring depth in cycles (the
+  // older snapshot is at least the whole depth back). Waiting also flushes an
+  // open --diff-batch, so a limit that cuts a batch short can not deadlock.
+  const uint64_t ring = wave_ring_depth() / 2;
+  unsigned spins = 0;
+  while (true) {
+    const uint64_t checked = dq->checked.load(std::memory_order_acquire);
+    if (head - checked < max_lag && (ring == 0 || checked == head ||
+        npc_cycle_count() - dq->rec[checked % DIFF_QUEUE_SIZE].clk < ring)) break;
+    if (dq->failed.load(std::memory_order_acquire)) report_failure();
+    dq->flush_req.store(true, std::memory_order_release);
+    cpu_relax(spins);
   }
+  if (spins) dq->flush_req.store(false, std::memory_order_release);
+  DiffRecord *r = &dq->rec[head % DIFF_QUEUE_SIZE];
+  r->seq = g_nr_guest_inst;
+  r->clk = npc_cycle_count();
+  r->pc = pc;
+  r->next_pc = next_pc;
+  r->instr = instr;
+  r->skip_ref = is_skip_ref || is_counter_csr(instr);
+  memcpy(r->gpr, reg_ptr, sizeof(r->gpr));
+  is_skip_ref = false;
+  dq->head.store(head + 1, std::memory_order_release);
 
-  if (is_skip_ref) {
-    ref_difftest_regcpy(&cpu, DIFFTEST_TO_REF);
-    is_skip_ref = false;
-    return;
+  nr_commit_store += ((instr & 0x7f) == 0x23);
+  // retried at the next commit while a store is in flight
+  if (unlikely(mem_check_interval && head + 1 >= mem_check_next) && dpi_store_count() == nr_commit_store) {
+    difftest_check_mem("periodic");
+    mem_check_next = head + 1 + mem_check_interval;
   }
-  ref_difftest_exec(1);
-  ref_difftest_regcpy(&ref_r, DIFFTEST_TO_DUT); //把REF的内容
-  checkregs(&ref_r, pc);
 }
 
 #else
 void init_difftest(char *ref_so_file, long img_size, int port) { }
+bool difftest_enabled() { return false; }
+void difftest_fast_forward(uint64_t n) { panic("--fast-forward needs CONFIG_DIFFTEST"); }
+void difftest_detach() { }
+void difftest_sync() { }
+void difftest_set_batch(uint64_t k) { }
+void difftest_set_mem_interval(uint64_t n) { }
+void difftest_mem_baseline(paddr_t page) { }
+void difftest_check_mem(const char *when) { }
 #endif
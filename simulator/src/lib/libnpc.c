@@ -0,0 +1,66 @@
+#include <common.h>
+#include <debug.h>
+#include <defs.h>
+#include <libnpc.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// An instance is a thread: built with NPC_LIB, every NPC_LOCAL variable of the
+// simulator is thread_local, so a new thread starts from the same state as a
+// new CPU process. init_monitor() and sdb_mainloop() run on it as main() does;
+// npc_exit() unwinds back here instead of ending the process, and the
+// npc_atexit() functions (close files, join the DiffTest checker, unmap pmem)
+// run when the instance ends.
+#ifdef NPC_LIB
+struct LibNpc {
+  std::vector<std::string> args;
+  std::thread thread;
+  int status;
+};
+
+typedef struct { int status; } NpcExit;
+
+static thread_local std::vector<void (*)()> at_exit;
+
+void npc_exit(int status) { throw NpcExit{status}; }
+void npc_atexit(void (*fn)()) { at_exit.push_back(fn); }
+
+static void instance_main(LibNpc *npc) {
+  std::vector<char *> argv;
+  for (std::string &a : npc->args) argv.push_back(&a[0]);
+  argv.push_back(NULL);
+  try {
+    sdb_set_batch_mode();
+    init_monitor(argv.size() - 1, argv.data());
+    sdb_mainloop();
+    npc->status = is_exit_status_bad();
+  } catch (const NpcExit &e) {
+    npc->status = e.status;
+  }
+  // like exit(): in reverse order, and an error in one does not skip the rest
+  while (!at_exit.empty()) {
+    void (*fn)() = at_exit.back();
+    at_exit.pop_back();
+    try { fn(); } catch (const NpcExit &e) { npc->status = 1; }
+  }
+  fflush(stdout);
+}
+
+LibNpc *libnpc_start(int argc, char **argv) {
+  LibNpc *npc = new LibNpc;
+  npc->args.assign(argv, argv + argc);
+  npc->status = 1;
+  npc->thread = std::thread(instance_main, npc);
+  return npc;
+}
+
+int libnpc_wait(LibNpc *npc) {
+  npc->thread.join();
+  int status = npc->status;
+  delete npc;
+  return status;
+}
+
+int libnpc_run(int argc, char **argv) { return libnpc_wait(libnpc_start(argc, argv)); }
+#endif
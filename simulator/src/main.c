@@ -1,8 +1,11 @@
 #include <common.h>
 #include <defs.h>
 
+// libnpc (NPC_LIB) has no main, instances start in src/lib/libnpc.c
+#ifndef NPC_LIB
 int main(int argc, char **argv){
   init_monitor(argc, argv);
   sdb_mainloop();
   return 0;
 }
+#endif
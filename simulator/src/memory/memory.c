@@ -2,22 +2,124 @@
 #include <common.h>
 #include <debug.h>
 #include <defs.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <mutex>
+#include <vector>
+
+
+// pmem 是 mmap(MAP_NORESERVE) 保留的地址空间，只有碰到的页才占内存。
+// CONFIG_MEM_RANDOM 时整块先是 PROT_NONE，第一次访问某页时在 SIGSEGV 里把它
+// 打开并填上随机字节；镜像按页 MAP_PRIVATE 映射进来 (pmem_map_file)。
+static NPC_LOCAL uint8_t *pmem = NULL;
+// the RTL reads pmem through this (npc_pmem.h)
+NPC_LOCAL uint8_t *npc_pmem = NULL;
+// pages written since init (image load or guest store), used by checkpoints
+static NPC_LOCAL uint8_t pmem_written[PMEM_NR_PAGES] = {};
+// pages stored to since the last DiffTest memory check (difftest_check_mem)
+static NPC_LOCAL uint8_t pmem_dirty[PMEM_NR_PAGES] = {};
+static NPC_LOCAL std::vector<uint32_t> dirty_list;
+// sees the overwritten data of every store (wave ring undo log)
+static NPC_LOCAL void (*pmem_write_hook)(paddr_t addr, int len, word_t old) = NULL;
+
+
+#ifdef CONFIG_MEM_RANDOM
+static NPC_LOCAL uint8_t fill_byte = 0;
+static struct sigaction old_segv;   // the handler is process-wide, pmem_fault looks at the faulting thread's pmem
+
+static void pmem_fault(int sig, siginfo_t *info, void *ctx) {
+  uint8_t *a = (uint8_t *)info->si_addr;
+  if (a >= pmem && a < pmem + CONFIG_MSIZE) {
+    uint8_t *page = (uint8_t *)((uintptr_t)a & ~(uintptr_t)(PMEM_PAGE_SIZE - 1));
+    if (mprotect(page, PMEM_PAGE_SIZE, PROT_READ | PROT_WRITE) == 0) {
+      memset(page, fill_byte, PMEM_PAGE_SIZE);
+      return;
+    }
+  }
+  // not ours: put the old handler back, the access faults again and crashes as usual
+  sigaction(SIGSEGV, &old_segv, NULL);
+}
+#endif
 
-
-static uint8_t pmem[CONFIG_MSIZE] PG_ALIGN = {}; 
-
+// registered with npc_atexit(): a libnpc instance gives its address space back
+static void free_mem() {
+  munmap(pmem, CONFIG_MSIZE);
+  pmem = npc_pmem = NULL;
+}
 
 void init_mem() {
-#if defined(CONFIG_PMEM_MALLOC)
-  pmem = malloc(CONFIG_MSIZE);
-  assert(pmem);
+  const int prot = MUXDEF(CONFIG_MEM_RANDOM, PROT_NONE, PROT_READ | PROT_WRITE);
+  void *p = mmap(NULL, CONFIG_MSIZE, prot, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  Assert(p != MAP_FAILED, "Can not reserve %d MB for pmem", CONFIG_MSIZE >> 20);
+  pmem = npc_pmem = (uint8_t *)p;
+  npc_atexit(free_mem);
+#ifdef CONFIG_MEM_RANDOM
+  fill_byte = rand();
+  static std::once_flag installed;
+  std::call_once(installed, [] {
+    struct sigaction sa = {};
+    sa.sa_sigaction = pmem_fault;
+    sa.sa_flags = SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGSEGV, &sa, &old_segv);
+  });
 #endif
-  IFDEF(CONFIG_MEM_RANDOM, memset(pmem, rand(), CONFIG_MSIZE));
   Log("physical memory area [" FMT_PADDR ", " FMT_PADDR "]", PMEM_LEFT, PMEM_RIGHT);
 }
 
+// Put [off, off + len) of fd at guest address addr. Whole pages are mapped
+// copy-on-write, a partial last page (or an unaligned range) is read in.
+void pmem_map_file(paddr_t addr, int fd, off_t off, size_t len) {
+  size_t mapped = 0;
+  if (((addr - CONFIG_MBASE) | off) % PMEM_PAGE_SIZE == 0) {
+    mapped = len & ~(size_t)(PMEM_PAGE_SIZE - 1);
+    if (mapped) {
+      void *p = mmap(guest_to_host(addr), mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, off);
+      Assert(p != MAP_FAILED, "Can not map the image at " FMT_PADDR, addr);
+    }
+  }
+  // read() into a PROT_NONE page fails with EFAULT instead of faulting, so
+  // the rest goes through a buffer
+  static NPC_LOCAL uint8_t buf[PMEM_PAGE_SIZE];
+  while (mapped < len) {
+    size_t n = len - mapped < sizeof(buf) ? len - mapped : sizeof(buf);
+    Assert(pread(fd, buf, n, off + mapped) == (ssize_t)n, "Short read from the image");
+    memcpy(guest_to_host(addr + mapped), buf, n);
+    mapped += n;
+  }
+  pmem_mark_written(addr, len);
+}
+
 uint8_t* guest_to_host(paddr_t paddr) { return pmem + paddr - CONFIG_MBASE; }
 
+void pmem_mark_written(paddr_t addr, size_t len) {
+  if (len == 0) return;
+  uint32_t first = (addr - CONFIG_MBASE) / PMEM_PAGE_SIZE;
+  uint32_t last  = (addr - CONFIG_MBASE + len - 1) / PMEM_PAGE_SIZE;
+  for (uint32_t i = first; i <= last && i < PMEM_NR_PAGES; i ++) pmem_written[i] = 1;
+}
+bool pmem_page_written(uint32_t page) { return pmem_written[page]; }
+
+const uint32_t *pmem_dirty_pages(size_t *n) { *n = dirty_list.size(); return dirty_list.data(); }
+void pmem_clear_dirty() {
+  for (uint32_t i : dirty_list) pmem_dirty[i] = 0;
+  dirty_list.clear();
+}
+
+// slow path of pmem_write, once per page between two memory checks
+static void set_dirty(uint32_t page) {
+  // a page nobody wrote still holds the random fill, which the reference does
+  // not have: give it the DUT contents before the first store lands
+  if (!pmem_written[page]) {
+    pmem_written[page] = 1;
+    IFDEF(CONFIG_DIFFTEST, difftest_mem_baseline(CONFIG_MBASE + page * PMEM_PAGE_SIZE));
+  }
+  pmem_dirty[page] = 1;
+  dirty_list.push_back(page);
+}
+void pmem_set_write_hook(void (*hook)(paddr_t addr, int len, word_t old)) { pmem_write_hook = hook; }
+
 static inline word_t host_read(void *addr, int len) {
   switch (len) {
     case 1: return *(uint8_t  *)addr;
@@ -43,7 +145,7 @@ static inline bool in_pmem(paddr_t addr) {
 }
 
 
-extern CPU_state cpu;
+extern NPC_LOCAL CPU_state cpu;
 
 
 
@@ -51,9 +153,16 @@ word_t pmem_read(paddr_t addr, int len){
   return host_read(guest_to_host(addr), len);
 }
 void pmem_write(paddr_t addr, int len, word_t data) {
+  // an unaligned store may straddle two pages
+  const uint32_t first = (addr - CONFIG_MBASE) / PMEM_PAGE_SIZE;
+  const uint32_t last  = (addr - CONFIG_MBASE + len - 1) / PMEM_PAGE_SIZE;
+  if (unlikely(!pmem_dirty[first])) set_dirty(first);
+  if (unlikely(!pmem_dirty[last]))  set_dirty(last);
+  if (unlikely(pmem_write_hook)) pmem_write_hook(addr, len, host_read(guest_to_host(addr), len));
   host_write(guest_to_host(addr), len, data);
 }
 static void out_of_bound(paddr_t addr) {
+  update_cpu_state();
   panic("in[npc] address = " FMT_PADDR " is out of bound of pmem [" FMT_PADDR ", " FMT_PADDR "] at pc = " FMT_WORD,
       addr, PMEM_LEFT, PMEM_RIGHT, cpu.pc);
 }
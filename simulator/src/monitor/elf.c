@@ -0,0 +1,110 @@
+#include <common.h>
+#include <debug.h>
+#include <defs.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// --elf=FILE: PT_LOAD segments go into pmem (when no raw image is given) and
+// the STT_FUNC entries of .symtab become an address-sorted index, so anything
+// that has a pc can ask which function it is in with a binary search.
+static NPC_LOCAL std::vector<Symbol> symtab;
+static NPC_LOCAL std::string strtab;   // copy of the ELF string table, Symbol::name points into it
+
+// [off, off + len) is inside a file of size bytes (no 32-bit wrap-around)
+static bool in_file(size_t off, size_t len, size_t size) { return off <= size && len <= size - off; }
+
+static void load_symbols(const uint8_t *base, size_t size, const char *file) {
+  const Elf32_Ehdr *eh = (const Elf32_Ehdr *)base;
+  Assert(eh->e_shnum == 0 || (eh->e_shentsize == sizeof(Elf32_Shdr) &&
+         in_file(eh->e_shoff, (size_t)eh->e_shnum * sizeof(Elf32_Shdr), size)),
+         "'%s': bad section header table", file);
+  const Elf32_Shdr *sh = (const Elf32_Shdr *)(base + eh->e_shoff);
+  for (int i = 0; i < eh->e_shnum; i ++) {
+    if (sh[i].sh_type != SHT_SYMTAB) continue;
+    Assert(sh[i].sh_link < eh->e_shnum, "'%s': bad string table index %u", file, sh[i].sh_link);
+    const Elf32_Shdr *str = &sh[sh[i].sh_link];
+    Assert(in_file(sh[i].sh_offset, sh[i].sh_size, size) && in_file(str->sh_offset, str->sh_size, size),
+           "'%s': bad symbol table", file);
+    strtab.assign((const char *)base + str->sh_offset, str->sh_size);
+    const Elf32_Sym *sym = (const Elf32_Sym *)(base + sh[i].sh_offset);
+    for (size_t j = 0; j < sh[i].sh_size / sizeof(Elf32_Sym); j ++) {
+      if (ELF32_ST_TYPE(sym[j].st_info) != STT_FUNC || sym[j].st_name >= strtab.size()) continue;
+      symtab.push_back({sym[j].st_value, sym[j].st_size, strtab.c_str() + sym[j].st_name});
+    }
+    break;
+  }
+  // aliases at the same address: keep the larger one
+  std::sort(symtab.begin(), symtab.end(), [](const Symbol &a, const Symbol &b) {
+    return a.addr != b.addr ? a.addr < b.addr : a.size > b.size;
+  });
+  symtab.erase(std::unique(symtab.begin(), symtab.end(),
+               [](const Symbol &a, const Symbol &b) { return a.addr == b.addr; }), symtab.end());
+  Log("%zu function symbols from %s", symtab.size(), file);
+}
+
+// Returns the size of the loaded range starting at RESET_VECTOR (what the
+// DiffTest reference has to copy).
+static long load_segments(int fd, const uint8_t *base, size_t size, const char *file) {
+  const Elf32_Ehdr *eh = (const Elf32_Ehdr *)base;
+  Assert(eh->e_entry == RESET_VECTOR, "'%s': entry " FMT_WORD " is not the reset vector", file, eh->e_entry);
+  Assert(eh->e_phnum > 0 && eh->e_phentsize == sizeof(Elf32_Phdr) &&
+         in_file(eh->e_phoff, (size_t)eh->e_phnum * sizeof(Elf32_Phdr), size),
+         "'%s': bad program header table", file);
+  const Elf32_Phdr *ph = (const Elf32_Phdr *)(base + eh->e_phoff);
+  paddr_t end = RESET_VECTOR;
+  for (int i = 0; i < eh->e_phnum; i ++) {
+    if (ph[i].p_type != PT_LOAD || ph[i].p_memsz == 0) continue;
+    paddr_t addr = ph[i].p_paddr;
+    Assert(addr >= PMEM_LEFT && (uint64_t)addr + ph[i].p_memsz - 1 <= PMEM_RIGHT,
+           "'%s': segment [" FMT_PADDR ", +%#x) is outside pmem", file, addr, ph[i].p_memsz);
+    Assert(ph[i].p_filesz <= ph[i].p_memsz && in_file(ph[i].p_offset, ph[i].p_filesz, size),
+           "'%s': segment [" FMT_PADDR ", +%#x) has bad file offset/size", file, addr, ph[i].p_memsz);
+    pmem_map_file(addr, fd, ph[i].p_offset, ph[i].p_filesz);
+    if (ph[i].p_memsz > ph[i].p_filesz) {
+      memset(guest_to_host(addr + ph[i].p_filesz), 0, ph[i].p_memsz - ph[i].p_filesz);
+      pmem_mark_written(addr + ph[i].p_filesz, ph[i].p_memsz - ph[i].p_filesz);
+    }
+    Log("ELF segment [" FMT_PADDR ", " FMT_PADDR ")", addr, addr + ph[i].p_memsz);
+    if (addr + ph[i].p_memsz > end) end = addr + ph[i].p_memsz;
+  }
+  return end - RESET_VECTOR;
+}
+
+long load_elf(const char *file, bool load) {
+  int fd = open(file, O_RDONLY);
+  Assert(fd >= 0, "Can not open '%s'", file);
+  struct stat st;
+  fstat(fd, &st);
+  void *m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  Assert(m != MAP_FAILED, "Can not map '%s'", file);
+  const uint8_t *base = (const uint8_t *)m;
+  const Elf32_Ehdr *eh = (const Elf32_Ehdr *)base;
+  Assert((size_t)st.st_size >= sizeof(Elf32_Ehdr) && memcmp(eh->e_ident, ELFMAG, SELFMAG) == 0 &&
+         eh->e_ident[EI_CLASS] == ELFCLASS32 && eh->e_machine == EM_RISCV,
+         "'%s' is not a riscv32 ELF file", file);
+
+  long size = load ? load_segments(fd, base, st.st_size, file) : 0;
+  load_symbols(base, st.st_size, file);
+  munmap(m, st.st_size);
+  close(fd);
+  return size;
+}
+
+// The function containing pc; a symbol without a size ends at the next one.
+const Symbol *symbol_lookup(vaddr_t pc) {
+  auto it = std::upper_bound(symtab.begin(), symtab.end(), pc,
+                             [](vaddr_t pc, const Symbol &s) { return pc < s.addr; });
+  if (it == symtab.begin()) return NULL;
+  const Symbol *s = &*(it - 1);
+  if (s->size != 0 && pc - s->addr >= s->size) return NULL;
+  return s;
+}
+
+size_t symbol_count() { return symtab.size(); }
+const Symbol *symbol_table() { return symtab.data(); }
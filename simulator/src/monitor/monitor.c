@@ -2,6 +2,10 @@
 #include <stdio.h>
 #include <debug.h>
 #include <defs.h>   //api
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <host_prof.h>
 
 static void welcome() {
   Log("Trace and IRingTrace: %s", MUXDEF(CONFIG_TRACE,        ANSI_FMT("ON", ANSI_FG_GREEN), ANSI_FMT("OFF", ANSI_FG_RED)));
@@ -18,33 +22,51 @@ static void welcome() {
 
 
 
-static char *img_file = NULL;
-static char *log_file = NULL;
-static char *diff_so_file = NULL;
-static int   difftest_port = 1234;
-static uint64_t max_commit = 0; // 0 means no limit
-static uint64_t pcpred_interval = 0; // 0 means disabled
+static NPC_LOCAL char *img_file = NULL;
+static NPC_LOCAL char *elf_file = NULL;
+static NPC_LOCAL char *log_file = NULL;
+static NPC_LOCAL char *diff_so_file = NULL;
+static NPC_LOCAL int   difftest_port = 1234;
+static NPC_LOCAL uint64_t max_commit = 0; // 0 means no limit
+static NPC_LOCAL uint64_t stats_interval_n = 0; // 0 means disabled
+static NPC_LOCAL char *stats_file = NULL;
+static NPC_LOCAL char *ckpt_restore_file = NULL;
+static NPC_LOCAL uint64_t fast_forward = 0; // 0 means disabled
+static NPC_LOCAL char *bbv_file = NULL;
+static NPC_LOCAL uint64_t bbv_interval = 1000000;
+static NPC_LOCAL int no_diff_check = false;
+static NPC_LOCAL char *wave_file = NULL;
+static NPC_LOCAL char *wave_window = NULL;
+static NPC_LOCAL int wave_cycles = false;
+static NPC_LOCAL uint64_t wave_ring = 0; // 0 means disabled
+static NPC_LOCAL char *commit_log_file = NULL;
+static NPC_LOCAL char *func_profile_file = NULL;
+static NPC_LOCAL char *pc_hist_file = NULL;
 
 static long load_img() {
+  // --elf alone: the program comes from the ELF; with an image: only its symbols
+  if (elf_file) {
+    long size = load_elf(elf_file, img_file == NULL);
+    if (img_file == NULL) return size;
+  }
   if (img_file == NULL) {
     Log("No image is given. Use the default build-in image.");
     return 4096; // built-in image size
   }
-  FILE *fp = fopen(img_file, "rb");
-  Assert(fp, "Can not open '%s'", img_file);
-  fseek(fp, 0, SEEK_END);
-  long size = ftell(fp);
+  int fd = open(img_file, O_RDONLY);
+  Assert(fd >= 0, "Can not open '%s'", img_file);
+  struct stat st;
+  fstat(fd, &st);
+  long size = st.st_size;
   Log("The image is %s, size = %ld", img_file, size);
 
-  fseek(fp, 0, SEEK_SET);
-  int ret = fread(guest_to_host(RESET_VECTOR), size, 1, fp);
-  assert(ret == 1);
-
-  fclose(fp);
+  pmem_map_file(RESET_VECTOR, fd, 0, size);
+  close(fd);
   return size;
 }
 
 #include <getopt.h> //
+#include <mutex>
 static int parse_args(int argc, char *argv[]) {
   const struct option table[] = {
     {"batch"    , no_argument      , NULL, 'b'},
@@ -53,14 +75,41 @@ static int parse_args(int argc, char *argv[]) {
     {"port"     , required_argument, NULL, 'p'},
     {"max-commit", required_argument, NULL, 'n'},
     {"pcpred-interval", required_argument, NULL, 'r'},
+    {"fast"     , no_argument      , NULL, 'f'},
+    {"save-checkpoint"   , required_argument, NULL, 'S'},
+    {"restore-checkpoint", required_argument, NULL, 'R'},
+    {"fast-forward"      , required_argument, NULL, 'F'},
+    {"warmup"            , required_argument, NULL, 'W'},
+    {"no-diff-check"     , no_argument      , NULL, 'N'},
+    {"bbv"               , required_argument, NULL, 'B'},
+    {"bbv-interval"      , required_argument, NULL, 'I'},
+    {"wave"              , required_argument, NULL, 'w'},
+    {"wave-window"       , required_argument, NULL, 'x'},
+    {"wave-cycles"       , no_argument      , NULL, 'c'},
+    {"wave-ring"         , required_argument, NULL, 'k'},
+    {"commit-log"        , required_argument, NULL, 'C'},
+    {"diff-batch"        , required_argument, NULL, 'K'},
+    {"diff-mem"          , required_argument, NULL, 'M'},
+    {"elf"               , required_argument, NULL, 'e'},
+    {"func-profile"      , required_argument, NULL, 'P'},
+    {"pc-hist"           , required_argument, NULL, 'H'},
+    {"stats"             , required_argument, NULL, 's'},
+    {"stats-interval"    , required_argument, NULL, 'i'},
+    {"host-profile"      , no_argument      , NULL, 'T'},
+    {"no-itrace"         , no_argument      , NULL, 'X'},
     {"help"     , no_argument      , NULL, 'h'},
     {0          , 0                , NULL,  0 },
   };
+  // getopt keeps its state in globals: libnpc instances parse one at a time
+  static std::mutex getopt_lock;
+  std::lock_guard<std::mutex> guard(getopt_lock);
+  optind = 0;
   int o;
   // Short options:
   // -n N : max-commit
-  // -r N : pcpred-interval
-  while ( (o = getopt_long(argc, argv, "-bhl:d:p:n:r:", table, NULL)) != -1) {
+  // -r N : pcpred-interval (same as --stats-interval)
+  // -f   : fast
+  while ( (o = getopt_long(argc, argv, "-bhfl:d:p:n:r:", table, NULL)) != -1) {
     switch (o) {
       case 'b': sdb_set_batch_mode();  break;
       case 'p': sscanf(optarg, "%d", &difftest_port); break;
@@ -73,10 +122,51 @@ static int parse_args(int argc, char *argv[]) {
         sdb_set_batch_max_commit(max_commit);
         break;
       case 'r':
-        // Periodic reporting for PC prediction (useful for showing how accuracy evolves).
-        sscanf(optarg, "%" SCNu64, &pcpred_interval);
-        sim_set_pcpred_report_interval(pcpred_interval);
+      case 'i':
+        // Interval windows of every statistic (useful for showing how accuracy evolves).
+        sscanf(optarg, "%" SCNu64, &stats_interval_n);
+        stats_set_interval(stats_interval_n);
+        break;
+      case 's': stats_file = optarg; break;
+      case 'T': host_prof_enable(); break;
+      case 'X': itrace_disable(); break;
+      case 'f':
+        // Fast batch mode: execute() says what still needs the per-commit loop.
+        sdb_set_batch_mode();
+        sim_set_fast_mode(1);
+        break;
+      case 'S': checkpoint_set_save(optarg); break;
+      case 'R': ckpt_restore_file = optarg;  break;
+      case 'F': sscanf(optarg, "%" SCNu64, &fast_forward); break;
+      case 'W': {
+        uint64_t warmup = 0;
+        sscanf(optarg, "%" SCNu64, &warmup);
+        sdb_set_batch_warmup(warmup);
+        break;
+      }
+      case 'N': no_diff_check = true; break;
+      case 'B': bbv_file = optarg;    break;
+      case 'I': sscanf(optarg, "%" SCNu64, &bbv_interval); break;
+      case 'w': wave_file = optarg;   break;
+      case 'x': wave_window = optarg; break;
+      case 'c': wave_cycles = true;   break;
+      case 'k': sscanf(optarg, "%" SCNu64, &wave_ring); break;
+      case 'C': commit_log_file = optarg; break;
+      case 'K': {
+        uint64_t k = 0;
+        sscanf(optarg, "%" SCNu64, &k);
+        difftest_set_batch(k);
         break;
+      }
+      case 'e': elf_file = optarg; break;
+      case 'P': func_profile_file = optarg; break;
+      case 'H': pc_hist_file = optarg; break;
+      case 'M': {
+        uint64_t n = 0;
+        sscanf(optarg, "%" SCNu64, &n);
+        difftest_set_mem_interval(n);
+        break;
+      }
       case 1:   img_file = optarg;     return 0;
       default:
         printf("Usage: %s [OPTION...] IMAGE [args]\n\n", argv[0]);
@@ -85,9 +175,31 @@ static int parse_args(int argc, char *argv[]) {
         printf("\t-d,--diff=REF_SO        run DiffTest with reference REF_SO\n");
         printf("\t-p,--port=PORT          run DiffTest with port PORT\n");
         printf("\t-n,--max-commit=N       stop after N committed instructions and print statistics\n");
-        printf("\t-r,--pcpred-interval=N  print PC prediction stats every N committed instructions (0=disabled)\n");
+        printf("\t-r,--pcpred-interval=N  same as --stats-interval=N\n");
+        printf("\t-f,--fast               batch mode, count commits/predictions in RTL (needs --no-itrace)\n");
+        printf("\t--save-checkpoint=FILE@N    save the simulation state to FILE after N commits\n");
+        printf("\t--restore-checkpoint=FILE   resume from a checkpoint saved by --save-checkpoint\n");
+        printf("\t--fast-forward=N            run the first N instructions in the DiffTest reference, then switch to RTL\n");
+        printf("\t--warmup=N                  batch mode: run N instructions before statistics start counting\n");
+        printf("\t--no-diff-check             only use the DiffTest reference for --fast-forward/--bbv\n");
+        printf("\t--bbv=FILE                  write SimPoint basic-block vectors (run in the reference) to FILE and exit\n");
+        printf("\t--bbv-interval=N            instructions per BBV interval (default 1000000)\n");
+        printf("\t--wave=FILE                 FST waveform file (default waveform.fst, debug build only)\n");
+        printf("\t--wave-window=START:END     dump the waveform for commits [START, END), END empty = to the end\n");
+        printf("\t--wave-cycles               --wave-window counts clock cycles instead of commits\n");
+        printf("\t--wave-ring=K               no waveform unless the run fails, then dump the last K..2K cycles\n");
+        printf("\t--commit-log=FILE           write a binary record per commit (read with npc-tracetool)\n");
+        printf("\t--diff-batch=K              DiffTest compares a state hash every K commits and bisects on mismatch\n");
+        printf("\t--elf=FILE                  load FILE (ELF) instead of a raw image, or with IMAGE only read its symbols\n");
+        printf("\t--func-profile=FILE         per-function cycles as collapsed stacks to FILE, totals to FILE.csv (CONFIG_FUNC_TRACE)\n");
+        printf("\t--pc-hist=FILE              per-pc commits and stall cycles, sorted and disassembled, to FILE\n");
+        printf("\t--stats=FILE                all statistics as JSON (CSV if FILE ends in .csv), final and per interval\n");
+        printf("\t--stats-interval=N          a statistics window every N commits, to --stats or the log (0=disabled)\n");
+        printf("\t--no-itrace                do not record committed instructions for the crash/sdb dump\n");
+        printf("\t--host-profile              report host time, KIPS and KCPS per simulator phase (eval, DPI, difftest, ...)\n");
+        printf("\t--diff-mem=N                compare the pages written by the DUT every N commits (default 1000000, 0 = only at the end)\n");
         printf("\n");
-        exit(0);
+        npc_exit(0);
     }
   }
   return 0;
@@ -132,18 +244,51 @@ static const uint32_t img [] = {
 
 void load_builded_img(){
  memcpy(guest_to_host(RESET_VECTOR), img, sizeof(img));
+ pmem_mark_written(RESET_VECTOR, sizeof(img));
 }
 
 
+// parse_args() 在 IMAGE 处提前返回, 波形设置放在这里, 不受参数顺序影响
+static void init_wave() {
+  Assert(!(wave_ring && wave_window), "--wave-ring and --wave-window can not be used together");
+  if (wave_ring) {
+    npc_set_wave(wave_file, 0, 0, false);  // empty window: only the crash replay dumps
+  } else if (wave_file || wave_window || wave_cycles) {
+    uint64_t start = MUXDEF(CONFIG_TRACE, CONFIG_TRACE_START, 0);
+    uint64_t end   = MUXDEF(CONFIG_TRACE, CONFIG_TRACE_END, UINT64_MAX);
+    if (wave_window) {
+      char *colon = strchr(wave_window, ':');
+      Assert(colon && sscanf(wave_window, "%" SCNu64, &start) == 1,
+             "Bad --wave-window '%s', expected START:END", wave_window);
+      if (sscanf(colon + 1, "%" SCNu64, &end) != 1) end = UINT64_MAX;
+    }
+    npc_set_wave(wave_file, start, end, wave_cycles);
+  }
+}
+
 void init_monitor(int argc, char **argv){
   parse_args(argc, argv);
+  init_wave();
   init_rand();
   init_log(log_file);
+  if (commit_log_file) commit_log_open(commit_log_file);
   init_mem();
   load_builded_img();
   long img_size = load_img();
+  if (func_profile_file) ftrace_open(func_profile_file);
+  if (pc_hist_file) pc_hist_open(pc_hist_file);
   npc_init();
+  if (stats_file) stats_open(stats_file);
   init_difftest(diff_so_file,img_size, difftest_port);
+  Assert(!(ckpt_restore_file && fast_forward), "--fast-forward and --restore-checkpoint can not be used together");
+  if (bbv_file) {
+    difftest_profile_bbv(bbv_file, bbv_interval);
+    npc_exit(0);
+  }
+  if (fast_forward) difftest_fast_forward(fast_forward);
+  if (no_diff_check) difftest_detach();
+  if (wave_ring) wave_ring_init(wave_ring);
+  if (ckpt_restore_file) checkpoint_restore(ckpt_restore_file);
 //  init_trace();
   init_sdb();
   init_disasm("riscv32-pc-linux-gnu");
@@ -70,7 +70,7 @@ static struct rule {
 
 #define NR_REGEX ARRLEN(rules) //NR_REGEX->Number Of Regular Expression
 
-static regex_t re[NR_REGEX] = {};
+static NPC_LOCAL regex_t re[NR_REGEX] = {};
 /* Rules are used for many times.
  * Therefore we compile them only once before any usage.
  */
@@ -97,8 +97,8 @@ typedef struct token {
   char str[token_str_len];
 } Token;
 
-static Token tokens[token_array_len] __attribute__((used)) = {}; 
-static int nr_token __attribute__((used))  = 0;       
+static NPC_LOCAL Token tokens[token_array_len] __attribute__((used)) = {}; 
+static NPC_LOCAL int nr_token __attribute__((used))  = 0;       
 
 //e为expression
 static bool make_token(char *e) {
@@ -5,8 +5,9 @@
 #include <readline/history.h>
 
 
-static int is_batch_mode = false;
-static uint64_t g_batch_max_commit = UINT64_MAX;
+static NPC_LOCAL int is_batch_mode = false;
+static NPC_LOCAL uint64_t g_batch_max_commit = UINT64_MAX;
+static NPC_LOCAL uint64_t g_batch_warmup = 0;
 static int cmd_help(char *args);
 static int cmd_c   (char *args);
 static int cmd_q   (char *args);
@@ -18,6 +19,7 @@ static int cmd_w   (char *args);
 static int cmd_d   (char *args);
 
 static int cmd_clear(char *args);
+static int cmd_wave(char *args);
 static struct {
   const char *name;
   const char *description;
@@ -33,6 +35,7 @@ static struct {
   { "w",    "add expression watched", cmd_w},
   { "d",    "delete expression watched", cmd_d},
   { "clear", "[clear]", cmd_clear},
+  { "wave", "wave on|off|auto: start/stop dumping the waveform, auto returns to the configured window", cmd_wave},
 };
 #define NR_CMD ARRLEN(cmd_table) 
 
@@ -102,6 +105,7 @@ static int cmd_info(char *args){
     printf("command format:\n");
     printf("info [r] --->display all regs\n");
     printf("info [w] --->display all watchpoints\n");
+    printf("info [i] --->display recently committed instructions (itrace)\n");
   }
 
   else if(strcmp(args, "r") == 0){
@@ -110,6 +114,9 @@ static int cmd_info(char *args){
   else if(strcmp(args, "w") == 0){
     wp_print();
   }
+  else if(strcmp(args, "i") == 0){
+    iringbuf_dump();
+  }
   return 0;
 }
 
@@ -192,8 +199,17 @@ void sdb_set_batch_max_commit(uint64_t n) {
   g_batch_max_commit = (n == 0) ? UINT64_MAX : n;
 }
 
+void sdb_set_batch_warmup(uint64_t n) {
+  g_batch_warmup = n;
+}
+
 void sdb_mainloop() {
   if (is_batch_mode) {
+    // Warm caches and predictors first; statistics only cover what follows.
+    if (g_batch_warmup > 0) {
+      cpu_exec(g_batch_warmup);
+      sim_begin_measurement();
+    }
     // If user sets a max commit count in batch mode, stop at the limit and print statistics.
     if (g_batch_max_commit != UINT64_MAX) sim_set_quit_on_limit(1);
     cpu_exec(g_batch_max_commit);
@@ -262,3 +278,18 @@ static int cmd_clear(char *args){
   printf("\033[1;1H\033[2J"); 
   return 0;
 }
+
+static int cmd_wave(char *args){
+  if (args == NULL) {
+    printf("Please Input: wave on|off|auto\n");
+  } else if (strcmp(args, "on") == 0) {
+    npc_wave_ctl(1);
+  } else if (strcmp(args, "off") == 0) {
+    npc_wave_ctl(0);
+  } else if (strcmp(args, "auto") == 0) {
+    npc_wave_ctl(-1);
+  } else {
+    printf("Unknown argument '%s', expected on|off|auto\n", args);
+  }
+  return 0;
+}
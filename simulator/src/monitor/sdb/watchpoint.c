@@ -2,6 +2,7 @@
 #include <common.h>
 #include <defs.h>
 #include <debug.h>
+#include <simulator_state.h>
 
 #define WP_NUMBER 10
 #define WP_EXPR_LEN 101
@@ -14,8 +15,9 @@ typedef struct {
   char expr[WP_EXPR_LEN];
   word_t value;
 }WP;
-static WP wp[WP_NUMBER];
-static int wp_cnt = 0;
+static NPC_LOCAL WP wp[WP_NUMBER];
+static NPC_LOCAL int wp_cnt = 0;
+extern NPC_LOCAL SIMState sim_state;
 
 void wp_init(){
   wp_cnt = 0;
@@ -67,6 +69,13 @@ void wp_del_watched(int num){
     }
   }
 }
+//有启用的监视点时, execute() 每条指令都要检查 (--fast 也就不能用)
+bool wp_enabled(){
+  for(int i = 0; i < WP_NUMBER; ++i){
+    if(wp[i].keep == 1) return true;
+  }
+  return false;
+}
 void wp_check_and_update(){
   int stop_flag = 0;
   for(int i = 0; i < WP_NUMBER; ++i){
@@ -84,9 +93,8 @@ void wp_check_and_update(){
       }       
     }
   }
-  if(stop_flag == 1){
-
-   // nemu_state.state = NEMU_STOP;
+  if(stop_flag == 1 && sim_state.state == SIM_RUNNING){
+    sim_state.state = SIM_STOP;
   }
 }
 
@@ -0,0 +1,101 @@
+#include <common.h>
+#include <defs.h>
+#include <debug.h>
+#include <verilated_save.h>
+
+// Checkpoint layout (one VerilatedSave stream):
+//   magic | model + sim.c statistics | written pmem pages | NEMU reference registers
+#define CKPT_MAGIC 0x3254504b4343504eull  // "NPCCKPT2"
+
+extern NPC_LOCAL CPU_state cpu;
+extern NPC_LOCAL uint64_t g_nr_guest_inst;
+extern NPC_LOCAL void (*ref_difftest_memcpy)(paddr_t addr, void *buf, size_t n, bool direction);
+extern NPC_LOCAL void (*ref_difftest_regcpy)(void *dut, bool direction);
+
+NPC_LOCAL uint64_t g_checkpoint_at = 0;  // commit count to save at, 0 means disabled
+static NPC_LOCAL const char *ckpt_file = NULL;
+
+// --save-checkpoint=FILE@N
+void checkpoint_set_save(const char *arg) {
+  static NPC_LOCAL char file[1024];
+  const char *at = strrchr(arg, '@');
+  Assert(at && at != arg && (size_t)(at - arg) < sizeof(file),
+         "Bad checkpoint '%s', expected FILE@N", arg);
+  memcpy(file, arg, at - arg);
+  file[at - arg] = '\0';
+  Assert(sscanf(at + 1, "%" SCNu64, &g_checkpoint_at) == 1 && g_checkpoint_at > 0,
+         "Bad checkpoint commit count in '%s'", arg);
+  ckpt_file = file;
+}
+
+void checkpoint_save() {
+  VerilatedSave os;
+  os.open(ckpt_file);
+  Assert(os.isOpen(), "Can not open checkpoint '%s'", ckpt_file);
+
+  uint64_t magic = CKPT_MAGIC;
+  os << magic;
+  npc_serialize(os);
+
+  uint32_t nr_page = 0;
+  for (uint32_t i = 0; i < PMEM_NR_PAGES; i ++) nr_page += pmem_page_written(i);
+  os << nr_page;
+  for (uint32_t i = 0; i < PMEM_NR_PAGES; i ++) {
+    if (!pmem_page_written(i)) continue;
+    os << i;
+    os.write(guest_to_host(CONFIG_MBASE + i * PMEM_PAGE_SIZE), PMEM_PAGE_SIZE);
+  }
+
+  bool has_ref = difftest_enabled();
+  os << has_ref;
+  difftest_sync();
+  if (has_ref) {
+    CPU_state ref_r;
+    ref_difftest_regcpy(&ref_r, DIFFTEST_TO_DUT);
+    os.write(&ref_r, sizeof(ref_r));
+  }
+  os.close();
+  Log("Checkpoint saved to %s at commit %" PRIu64 " (%u pages)", ckpt_file, g_nr_guest_inst, nr_page);
+}
+
+void checkpoint_restore(const char *file) {
+  VerilatedRestore is;
+  is.open(file);
+  Assert(is.isOpen(), "Can not open checkpoint '%s'", file);
+
+  uint64_t magic = 0;
+  is >> magic;
+  Assert(magic == CKPT_MAGIC, "'%s' is not a checkpoint", file);
+  npc_deserialize(is);
+
+  uint32_t nr_page = 0;
+  is >> nr_page;
+  for (uint32_t n = 0; n < nr_page; n ++) {
+    uint32_t i = 0;
+    is >> i;
+    Assert(i < PMEM_NR_PAGES, "Bad page index %u in checkpoint '%s'", i, file);
+    paddr_t addr = CONFIG_MBASE + i * PMEM_PAGE_SIZE;
+    is.read(guest_to_host(addr), PMEM_PAGE_SIZE);
+    pmem_mark_written(addr, PMEM_PAGE_SIZE);
+    if (difftest_enabled()) ref_difftest_memcpy(addr, guest_to_host(addr), PMEM_PAGE_SIZE, DIFFTEST_TO_REF);
+  }
+
+  bool has_ref = false;
+  is >> has_ref;
+  if (has_ref) {
+    CPU_state ref_r;
+    is.read(&ref_r, sizeof(ref_r));
+    if (difftest_enabled()) ref_difftest_regcpy(&ref_r, DIFFTEST_TO_REF);
+  } else if (difftest_enabled()) {
+    // no reference state saved: start the reference from the DUT registers
+    update_cpu_state();
+    ref_difftest_regcpy(&cpu, DIFFTEST_TO_REF);
+  }
+  is.close();
+
+  if (g_checkpoint_at != 0 && g_checkpoint_at <= g_nr_guest_inst) {
+    Log("Checkpoint commit %" PRIu64 " is already behind the restored state, not saving", g_checkpoint_at);
+    g_checkpoint_at = 0;
+  }
+  Log("Checkpoint restored from %s at commit %" PRIu64 " (%u pages)", file, g_nr_guest_inst, nr_page);
+}
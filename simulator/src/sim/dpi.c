@@ -2,6 +2,7 @@
 #include <cstdio>
 #include <defs.h>
 #include "verilated_dpi.h" // For VerilatedDpiOpenVar and other DPI related definitions
+#include <host_prof.h>
 
 
 
@@ -14,6 +15,7 @@ extern "C" void dpi_ebreak(int pc){
 }
 
 extern "C" int dpi_mem_read(int addr, int len){
+	HOST_PHASE(HOST_DPI_MEM);
 	// printf("addr = %x, len = %d\n", addr, len);
 	if(addr == 0) return 0;
 	if(addr >=  CONFIG_RTC_MMIO && addr < CONFIG_RTC_MMIO + 4){
@@ -26,12 +28,22 @@ extern "C" int dpi_mem_read(int addr, int len){
 		return data;
 	}else{
 		printf("你将要访问的内存地址是0x%x, 不属于内存地址[0x80000000, 0x8ffffffff], 程序即将出错退出\n", addr);
+		iringbuf_dump();
+		if (wave_ring_request("out-of-range dpi_mem_read")) return 0;
 		npc_close_simulation();
-		exit(1);
+		npc_exit(1);
 	}
 }
+// stores issued by the RTL, committed or not (difftest_check_mem)
+static NPC_LOCAL uint64_t nr_store = 0;
+uint64_t dpi_store_count() { return nr_store; }
+
 extern "C" void dpi_mem_write(int addr, int data, int len){
+	HOST_PHASE(HOST_DPI_MEM);
+	nr_store ++;
 	if(addr == CONFIG_SERIAL_MMIO){
+		// --wave-ring 重放时这些字符已经输出过了
+		if (unlikely(wave_ring_replaying())) return;
 		char ch = data;
 		printf("%c", ch);
 		fflush(stdout);
@@ -42,14 +54,35 @@ extern "C" void dpi_mem_write(int addr, int data, int len){
 	}
 	else{
 		printf("你将要访问的内存地址是0x%x, 不属于内存地址[0x80000000, 0x8ffffffff], 程序即将出错退出\n", addr);
+		iringbuf_dump();
+		if (wave_ring_request("out-of-range dpi_mem_write")) return;
 		npc_close_simulation();
-		exit(1);
+		npc_exit(1);
 		
 	}
 }
 
 
-extern uint32_t  *reg_ptr;
+extern NPC_LOCAL uint32_t  *reg_ptr;
 extern "C" void dpi_read_regfile(const svOpenArrayHandle r) {
   reg_ptr = (uint32_t *)(((VerilatedDpiOpenVar*)r)->datap());
 }
+
+// Architectural state the core resets into; npc_load_arch_state() changes it
+// so a reset can start the RTL from a fast-forwarded NEMU state.
+static NPC_LOCAL word_t reset_pc = RESET_VECTOR;
+static NPC_LOCAL word_t reset_csr[CSR_NUM] = {};
+void npc_set_reset_state(vaddr_t pc, const word_t *csr) {
+  reset_pc = pc;
+  memcpy(reset_csr, csr, sizeof(reset_csr));
+}
+extern "C" int dpi_reset_pc() { return reset_pc; }
+extern "C" int dpi_reset_csr(int addr) {
+  switch (addr) {
+    case MSTATUS_IDX: return reset_csr[MSTATUS];
+    case MTVEC_IDX:   return reset_csr[MTVEC];
+    case MEPC_IDX:    return reset_csr[MEPC];
+    case MCAUSE_IDX:  return reset_csr[MCAUSE];
+    default:          return 0;
+  }
+}
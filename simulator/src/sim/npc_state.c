@@ -1,7 +1,7 @@
 #include <common.h>
 #include <simulator_state.h>
 
-SIMState sim_state = {.state = SIM_STOP};
+NPC_LOCAL SIMState sim_state = {.state = SIM_STOP};
 
 int is_exit_status_bad() {
   int good = (sim_state.state == SIM_END && sim_state.halt_ret == 0) 
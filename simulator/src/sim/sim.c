@@ -3,8 +3,11 @@
 #include <debug.h>
 #include <sys/types.h>
 #include <verilated.h>
-#include <verilated_vcd_c.h>
+#include <verilated_fst_c.h>
+#include <verilated_save.h>
 #include <npc.h>
+#include <host_prof.h>
+#include <string>
 
 
 
@@ -12,126 +15,293 @@
 #include <common.h>
 #include <defs.h>
 
-extern CPU_state  cpu;
-extern SIMState  sim_state;
-uint64_t          g_nr_guest_inst = 0;
-static uint64_t   g_timer = 0; // unit: us
-static bool       g_print_step = false;
+extern NPC_LOCAL CPU_state cpu;
+extern NPC_LOCAL SIMState  sim_state;
+NPC_LOCAL uint64_t        g_nr_guest_inst = 0;
+static NPC_LOCAL uint64_t g_timer = 0; // unit: us
+static NPC_LOCAL bool     g_print_step = false;
 #define MAX_INST_TO_PRINT 100
 
 
-static TOP_NAME dut;  			    //CPU
-static VerilatedVcdC *m_trace;  //仿真波形
-static word_t sim_time = 0;			//时间
-static word_t clk_count = 0;
+// 每个实例有自己的 VerilatedContext (libnpc 里一个进程有多个实例)
+static NPC_LOCAL VerilatedContext vl_ctx;
+static NPC_LOCAL TOP_NAME dut(&vl_ctx);  //CPU
+static NPC_LOCAL VerilatedFstC *m_trace;  //仿真波形
+static NPC_LOCAL uint64_t sim_time = 0;   //时间
+static NPC_LOCAL uint64_t clk_count = 0;
 
 // PC prediction statistics (for control-flow instructions)
-static uint64_t g_pc_pred_total = 0;
-static uint64_t g_pc_pred_correct = 0;
+static NPC_LOCAL uint64_t g_pc_pred_total = 0;
+static NPC_LOCAL uint64_t g_pc_pred_correct = 0;
 // Split statistics
-static uint64_t g_pc_pred_b_total = 0;
-static uint64_t g_pc_pred_b_correct = 0;
+static NPC_LOCAL uint64_t g_pc_pred_b_total = 0;
+static NPC_LOCAL uint64_t g_pc_pred_b_correct = 0;
 // Split B-type into forward/backward (roughly if vs loop)
-static uint64_t g_pc_pred_b_fwd_total = 0;
-static uint64_t g_pc_pred_b_fwd_correct = 0;
-static uint64_t g_pc_pred_b_bwd_total = 0;
-static uint64_t g_pc_pred_b_bwd_correct = 0;
-static uint64_t g_pc_pred_jalr_total = 0; // includes RET
-static uint64_t g_pc_pred_jalr_correct = 0;
+static NPC_LOCAL uint64_t g_pc_pred_b_fwd_total = 0;
+static NPC_LOCAL uint64_t g_pc_pred_b_fwd_correct = 0;
+static NPC_LOCAL uint64_t g_pc_pred_b_bwd_total = 0;
+static NPC_LOCAL uint64_t g_pc_pred_b_bwd_correct = 0;
+static NPC_LOCAL uint64_t g_pc_pred_jalr_total = 0; // includes RET
+static NPC_LOCAL uint64_t g_pc_pred_jalr_correct = 0;
+static NPC_LOCAL uint64_t g_pc_pred_jal_total = 0;
+static NPC_LOCAL uint64_t g_pc_pred_jal_correct = 0;
 
 // When enabled, reaching the step limit (cpu_exec(n)) will stop the simulation with SIM_QUIT,
 // so statistics are printed (useful for fixed-window benchmarks in batch mode).
-static int g_quit_on_limit = 0;
+static NPC_LOCAL int g_quit_on_limit = 0;
 void sim_set_quit_on_limit(int en) { g_quit_on_limit = en ? 1 : 0; }
 
-// Periodic PC prediction reporting
-static uint64_t g_pcpred_report_interval = 0; // 0 means disabled
-void sim_set_pcpred_report_interval(uint64_t interval) { g_pcpred_report_interval = interval; }
-
-// Snapshot for windowed reporting
-static uint64_t g_last_report_guest_inst = 0;
-static uint64_t g_last_report_cf_total = 0;
-static uint64_t g_last_report_cf_correct = 0;
-
-static void pcpred_maybe_report_progress() {
-  if (g_pcpred_report_interval == 0) return;
-  if (g_nr_guest_inst == 0) return;
-  if (g_nr_guest_inst % g_pcpred_report_interval != 0) return;
-
-  const uint64_t cf_total = g_pc_pred_total;
-  const uint64_t cf_correct = g_pc_pred_correct;
-  const uint64_t cf_wrong = (cf_total >= cf_correct) ? (cf_total - cf_correct) : 0;
-
-  const uint64_t win_inst = g_nr_guest_inst - g_last_report_guest_inst;
-  const uint64_t win_cf_total = cf_total - g_last_report_cf_total;
-  const uint64_t win_cf_correct = cf_correct - g_last_report_cf_correct;
-  const uint64_t win_cf_wrong = (win_cf_total >= win_cf_correct) ? (win_cf_total - win_cf_correct) : 0;
-
-  double rate = 0.0, win_rate = 0.0;
-  if (cf_total > 0) rate = (double)cf_correct * 100.0 / (double)cf_total;
-  if (win_cf_total > 0) win_rate = (double)win_cf_correct * 100.0 / (double)win_cf_total;
-
-  // A single, parse-friendly progress line for scripts.
-  // Meaning:
-  // - commit: total committed instructions so far
-  // - win_inst: instructions since last report
-  // - cf_total/cf_correct/cf_wrong: cumulative control-flow prediction stats
-  // - cf_rate: cumulative success rate
-  // - win_cf_* / win_cf_rate: window success rate for the last interval
-  Log("[PCPRED] commit=%" PRIu64 " win_inst=%" PRIu64
-      " cf_total=%" PRIu64 " cf_correct=%" PRIu64 " cf_wrong=%" PRIu64 " cf_rate=%.2f%%"
-      " win_cf_total=%" PRIu64 " win_cf_correct=%" PRIu64 " win_cf_wrong=%" PRIu64 " win_cf_rate=%.2f%%",
-      g_nr_guest_inst, win_inst,
-      cf_total, cf_correct, cf_wrong, rate,
-      win_cf_total, win_cf_correct, win_cf_wrong, win_rate);
-
-  g_last_report_guest_inst = g_nr_guest_inst;
-  g_last_report_cf_total = cf_total;
-  g_last_report_cf_correct = cf_correct;
+// Fast mode: clock the model in blocks and take commit/prediction totals from
+// the RTL commit_stat counters instead of decoding every commit on the host.
+static NPC_LOCAL int g_fast_mode = 0;
+void sim_set_fast_mode(int en) { g_fast_mode = en ? 1 : 0; }
+#define FAST_BLOCK_CYCLES 4096
+
+// commit_stat counter -> host counter. The host counters advance by the
+// difference since the last sync, so checkpoints and resets of the model do
+// not move them.
+#define HW_STAT_LIST(f) \
+  f(stat_commit,        g_nr_guest_inst) \
+  f(stat_b_fwd_total,   g_pc_pred_b_fwd_total) \
+  f(stat_b_fwd_correct, g_pc_pred_b_fwd_correct) \
+  f(stat_b_bwd_total,   g_pc_pred_b_bwd_total) \
+  f(stat_b_bwd_correct, g_pc_pred_b_bwd_correct) \
+  f(stat_jal_total,     g_pc_pred_jal_total) \
+  f(stat_jal_correct,   g_pc_pred_jal_correct) \
+  f(stat_jalr_total,    g_pc_pred_jalr_total) \
+  f(stat_jalr_correct,  g_pc_pred_jalr_correct)
+#define HW_STAT_FIELD(hw, sw) uint64_t hw;
+static NPC_LOCAL struct { HW_STAT_LIST(HW_STAT_FIELD) } g_hw_last = {};
+
+static void pcpred_sync_from_hw() {
+#define HW_STAT_SYNC(hw, sw) sw += dut.hw - g_hw_last.hw; g_hw_last.hw = dut.hw;
+  HW_STAT_LIST(HW_STAT_SYNC)
+  g_pc_pred_b_total   = g_pc_pred_b_fwd_total + g_pc_pred_b_bwd_total;
+  g_pc_pred_b_correct = g_pc_pred_b_fwd_correct + g_pc_pred_b_bwd_correct;
+  g_pc_pred_total     = g_pc_pred_b_total + g_pc_pred_jal_total + g_pc_pred_jalr_total;
+  g_pc_pred_correct   = g_pc_pred_b_correct + g_pc_pred_jal_correct + g_pc_pred_jalr_correct;
+}
+// called whenever the model counters jump (reset, checkpoint restore)
+static void pcpred_rebase_hw() {
+#define HW_STAT_REBASE(hw, sw) g_hw_last.hw = dut.hw;
+  HW_STAT_LIST(HW_STAT_REBASE)
+}
+
+// CPI stack: every cycle goes to one category. A cycle with a commit is base.
+// CPU.cpi_event (CPI_* in define.v, same numbering) queues the bubbles that a
+// stall or squash inserts, and the following cycles without a commit are
+// charged to them in order. A cycle without a commit and without a queued
+// bubble (icache miss, pipeline fill) is "other".
+enum { CPI_BASE, CPI_LOAD_USE, CPI_BR_MISPRED, CPI_JALR_MISPRED, CPI_SYS_REDIRECT, CPI_OTHER, NR_CPI };
+static const char *cpi_name[NR_CPI] = {"base", "load_use", "br_mispred", "jalr_mispred", "sys_redirect", "other"};
+static const int cpi_bubbles[CPI_OTHER] = {0, 1, 2, 2, 2};   // a load-use stall holds decode, a squash kills fetch + decode
+static NPC_LOCAL uint64_t g_cpi[NR_CPI] = {};
+static NPC_LOCAL uint8_t  cpi_queue[16];
+static NPC_LOCAL uint32_t cpi_q_head = 0, cpi_q_tail = 0;
+
+static inline void cpi_account() {
+  if (dut.commit) g_cpi[CPI_BASE] ++;
+  else g_cpi[cpi_q_head != cpi_q_tail ? cpi_queue[cpi_q_head ++ % 16] : CPI_OTHER] ++;
+  const int ev = dut.cpi_event;
+  if (unlikely(ev != 0 && ev < CPI_OTHER)) {
+    for (int i = 0; i < cpi_bubbles[ev] && cpi_q_tail - cpi_q_head < 16; i ++) cpi_queue[cpi_q_tail ++ % 16] = ev;
+  }
+}
+
+// Everything statistic() and --stats report (see stats.c). Registered
+// unconditionally, a checkpoint stores the counters in this order.
+static void sim_register_stats() {
+  stat_scalar("sim.commit", &g_nr_guest_inst, "committed instructions");
+  stat_scalar("sim.cycle", &clk_count, "clock cycles");
+  stat_ratio ("sim.ipc", "sim.commit", "sim.cycle", 1, "instructions per cycle");
+  stat_scalar("host.time_us", &g_timer, "host time in cpu_exec");
+  stat_ratio ("host.inst_per_sec", "sim.commit", "host.time_us", 1e6, "simulation speed");
+  stat_hist  ("host.tsc", g_host_tsc, NR_HOST_PHASE, host_phase_name, "host TSC ticks per phase (--host-profile)");
+
+  stat_hist("cpi_cycles", g_cpi, NR_CPI, cpi_name, "CPI stack: cycles per category");
+  for (int i = 0; i < NR_CPI; i ++) {
+    stat_ratio((std::string("cpi.") + cpi_name[i]).c_str(), (std::string("cpi_cycles.") + cpi_name[i]).c_str(),
+               "sim.commit", 1, "CPI stack: cycles per instruction");
+  }
+
+#define PCPRED_STATS(name, total, correct, what) \
+  stat_scalar("pcpred." name ".total", &total, what); \
+  stat_scalar("pcpred." name ".correct", &correct, what ", predicted correctly"); \
+  stat_diff  ("pcpred." name ".wrong", "pcpred." name ".total", "pcpred." name ".correct", what ", mispredicted"); \
+  stat_ratio ("pcpred." name ".rate", "pcpred." name ".correct", "pcpred." name ".total", 100, what ", success rate %");
+  PCPRED_STATS("all",   g_pc_pred_total,       g_pc_pred_correct,       "control-flow instructions")
+  PCPRED_STATS("b",     g_pc_pred_b_total,     g_pc_pred_b_correct,     "B-type")
+  PCPRED_STATS("b_fwd", g_pc_pred_b_fwd_total, g_pc_pred_b_fwd_correct, "B-type, imm_b >= 0")
+  PCPRED_STATS("b_bwd", g_pc_pred_b_bwd_total, g_pc_pred_b_bwd_correct, "B-type, imm_b < 0")
+  PCPRED_STATS("jal",   g_pc_pred_jal_total,   g_pc_pred_jal_correct,   "JAL")
+  PCPRED_STATS("jalr",  g_pc_pred_jalr_total,  g_pc_pred_jalr_correct,  "JALR/RET")
+#undef PCPRED_STATS
+}
+
+void sim_begin_measurement() {
+  stats_begin();
+  Log("Measurement starts at commit %" PRIu64 ", cycle %" PRIu64, g_nr_guest_inst, clk_count);
+}
+
+static inline void stats_maybe_window() {
+  const uint64_t n = stats_interval();
+  if (n != 0 && g_nr_guest_inst % n == 0) stats_window();
 }
 
 void npc_get_clk_count(){
-  printf("你的处理器运行了%u个clk\n", clk_count);
+  printf("你的处理器运行了%" PRIu64 "个clk\n", clk_count);
+}
+uint64_t npc_cycle_count() { return clk_count; }
+
+
+// 波形窗口：只在 [start, end) 之间 dump，单位默认是 commit 数 (--wave-cycles 改成 clk)。
+// 默认窗口来自 CONFIG_TRACE_START/END；sdb 的 wave on/off 可以手动接管。
+// FST 的压缩和写文件由 Verilator 的 trace 线程完成 (--trace-threads)。
+static NPC_LOCAL const char *g_wave_file = "waveform.fst";
+static NPC_LOCAL uint64_t g_wave_start = MUXDEF(CONFIG_TRACE, CONFIG_TRACE_START, 0);
+static NPC_LOCAL uint64_t g_wave_end   = MUXDEF(CONFIG_TRACE, CONFIG_TRACE_END, UINT64_MAX);
+static NPC_LOCAL bool     g_wave_cycle_unit = false;
+static NPC_LOCAL bool     g_wave_manual = false;
+static NPC_LOCAL bool     g_wave_on = false;
+
+void npc_set_wave(const char *file, uint64_t start, uint64_t end, int cycle_unit) {
+  if (file) g_wave_file = file;
+  g_wave_start = start;
+  g_wave_end = end;
+  g_wave_cycle_unit = cycle_unit;
 }
 
+#ifdef CONFIG_NPC_OPEN_SIM
+static void wave_switch(bool on) {
+  if (on == g_wave_on) return;
+  g_wave_on = on;
+  if (on && !m_trace->isOpen()) m_trace->open(g_wave_file);
+  if (!on) m_trace->flush();
+  Log("Waveform %s at commit %" PRIu64 ", cycle %" PRIu64, on ? "starts" : "stops", g_nr_guest_inst, clk_count);
+}
+
+static inline void wave_gate() {
+  if (g_wave_manual) return;
+  uint64_t now = g_wave_cycle_unit ? clk_count : g_nr_guest_inst;
+  bool on = (now >= g_wave_start && now < g_wave_end);
+  if (on != g_wave_on) wave_switch(on);
+}
+
+// fast mode only syncs the commit count per block, so end blocks at the window edges
+static uint64_t wave_cap_block(uint64_t done, uint64_t cycles) {
+  if (g_wave_manual || g_wave_cycle_unit) return cycles;
+  if (g_wave_start > done && cycles > g_wave_start - done) cycles = g_wave_start - done;
+  if (g_wave_end > done && cycles > g_wave_end - done) cycles = g_wave_end - done;
+  return cycles;
+}
+#endif
+
+// sdb: 1 = on, 0 = off, -1 = back to the window
+void npc_wave_ctl(int mode) {
+#ifdef CONFIG_NPC_OPEN_SIM
+  g_wave_manual = (mode >= 0);
+  if (g_wave_manual) wave_switch(mode);
+  else wave_gate();
+#else
+  printf("Waveform is only available in builds with --trace-fst (make debug)\n");
+#endif
+}
 
 void npc_open_simulation(){
-  Verilated::traceEverOn(true);
-  m_trace= new VerilatedVcdC;
+#ifdef CONFIG_NPC_OPEN_SIM
+  vl_ctx.traceEverOn(true);
+  m_trace= new VerilatedFstC;
   dut.trace(m_trace, 5);
-  m_trace->open("waveform.vcd");
-  Log("NPC open simulation");
+  // 窗口为空 (--wave-ring) 时不建文件, 第一次 wave_switch(true) 再打开
+  if (g_wave_start < g_wave_end) m_trace->open(g_wave_file);
+  npc_atexit(npc_close_simulation);   // the FST writer thread has to stop before the model goes away
+  Log("NPC open simulation: %s, %s [%" PRIu64 ", %" PRIu64 ")", g_wave_file,
+      g_wave_cycle_unit ? "cycles" : "commits", g_wave_start, g_wave_end);
+#endif
 }
 void npc_close_simulation(){
-  IFDEF(CONFIG_NPC_OPEN_SIM, 	m_trace->close());
-  IFDEF(CONFIG_NPC_OPEN_SIM, Log("NPC close simulation"));
+#ifdef CONFIG_NPC_OPEN_SIM
+  if (!m_trace->isOpen()) return;
+  m_trace->close();
+  Log("NPC close simulation");
+#endif
 }
 
 
-extern uint32_t * reg_ptr;
+extern NPC_LOCAL uint32_t * reg_ptr;
+// cpu is synced from the model lazily: every clock only marks it stale, and
+// consumers (difftest, sdb, watchpoints, expr) call update_cpu_state() first.
+static NPC_LOCAL bool g_cpu_state_stale = true;
 void update_cpu_state(){
+  if (!g_cpu_state_stale) return;
+  HOST_PHASE(HOST_CPU_STATE);
   cpu.pc = dut.cur_pc;
   memcpy(&cpu.gpr[0], reg_ptr, 4 * 32);
+  g_cpu_state_stale = false;
+}
+static inline void eval() {
+  HOST_PHASE(HOST_EVAL);
+  dut.eval();
+}
+static inline void wave_dump() {
+#ifdef CONFIG_NPC_OPEN_SIM
+  if (!g_wave_on) return;
+  HOST_PHASE(HOST_WAVE);
+  m_trace->dump(sim_time);
+#endif
 }
 void npc_single_cycle() {
+  IFDEF(CONFIG_NPC_OPEN_SIM, wave_gate());
+  cpi_account();
   dut.clk = 0; 
-  dut.eval();   
-  IFDEF(CONFIG_NPC_OPEN_SIM,   m_trace->dump(sim_time++));
+  eval();
+  wave_dump();
+  sim_time++;
   dut.clk = 1;  
-  dut.eval();
-  IFDEF(CONFIG_NPC_OPEN_SIM,   m_trace->dump(sim_time++));
+  eval();
+  wave_dump();
+  sim_time++;
   clk_count++;
-  update_cpu_state();
+  IFDEF(CONFIG_NPC_OPEN_SIM, if (unlikely(g_wave_ring_on)) wave_ring_cycle(clk_count));
+  g_cpu_state_stale = true;
 }
+// Model and statistics part of a checkpoint (see checkpoint.c).
+void npc_serialize(VerilatedSerialize &os) {
+  os << dut;
+  os << sim_time;
+  stats_serialize(os);
+}
+void npc_deserialize(VerilatedDeserialize &is) {
+  is >> dut;
+  is >> sim_time;
+  stats_deserialize(is);
+  cpi_q_head = cpi_q_tail = 0;
+  g_cpu_state_stale = true;
+  pcpred_rebase_hw();
+}
+
 void npc_reset(int n) {
   dut.rst = 1;
   while (n -- > 0) npc_single_cycle();
   dut.rst = 0;
+  pcpred_rebase_hw();
+}
+
+// Restart the core from an architectural state (used by fast-forward):
+// PC and CSRs are loaded during reset, the GPRs are written through reg_ptr.
+// Caches, predictors and the pipeline start cold.
+void npc_load_arch_state(const CPU_state *s) {
+  npc_set_reset_state(s->pc, s->csr);
+  npc_reset(1);
+  memcpy(reg_ptr, &s->gpr[0], 4 * 32);
+  g_cpu_state_stale = true;
 }
 
 void npc_init() {
+  sim_register_stats();
   IFDEF(CONFIG_NPC_OPEN_SIM, npc_open_simulation());  
   npc_reset(1);
+  update_cpu_state();
   if(cpu.pc != 0x80000000){
     npc_close_simulation();
     printf("当前cpu.pc为%d\n", cpu.pc);
@@ -142,9 +312,56 @@ void npc_init() {
 
 
 
-word_t commit_pre_pc = 0; 
+NPC_LOCAL word_t commit_pre_pc = 0; 
+
+
+// At most one instruction commits per cycle, so clocking min(commits left, commits
+// to the next report) cycles can never overshoot the limit or a report boundary.
+static void execute_fast(uint64_t n) {
+  pcpred_sync_from_hw();
+  const uint64_t start = g_nr_guest_inst;
+  const uint64_t target = (n > UINT64_MAX - start) ? UINT64_MAX : start + n;
+  uint64_t done = start;
+  while (sim_state.state == SIM_RUNNING && done < target) {
+    uint64_t cycles = target - done;
+    if (stats_interval() != 0) {
+      uint64_t to_report = stats_interval() - done % stats_interval();
+      if (cycles > to_report) cycles = to_report;
+    }
+    if (g_checkpoint_at > done && cycles > g_checkpoint_at - done) cycles = g_checkpoint_at - done;
+    if (cycles > FAST_BLOCK_CYCLES) cycles = FAST_BLOCK_CYCLES;
+    IFDEF(CONFIG_NPC_OPEN_SIM, cycles = wave_cap_block(done, cycles));
+    while (cycles -- > 0) {
+      npc_single_cycle();
+      if (sim_state.state != SIM_RUNNING) {
+        npc_single_cycle();                         // let ebreak retire, as execute() does
+        break;
+      }
+    }
+    pcpred_sync_from_hw();
+    done = g_nr_guest_inst;
+    if (stats_interval() != 0 && done % stats_interval() == 0) stats_window();
+    if (done == g_checkpoint_at && sim_state.state == SIM_RUNNING) checkpoint_save();
+  }
+  if (g_quit_on_limit && done >= target && sim_state.state == SIM_RUNNING) {
+    set_sim_state(SIM_QUIT, dut.cur_pc, 0);
+  }
+}
+
 //si 1执行一条指令就确定是一次commit, 而不是多次clk
 void execute(uint64_t n){
+  if (g_fast_mode) {
+    // DiffTest, itrace, watchpoints, the commit log and the profilers have to
+    // see every commit, so they keep the per-instruction loop.
+    if (!difftest_enabled() && !itrace_enabled() && !wp_enabled() &&
+        !commit_log_enabled() && !ftrace_enabled() && !pc_hist_enabled()) {
+      execute_fast(n);
+      return;
+    }
+    static NPC_LOCAL bool warned = false;
+    if (!warned) Log("--fast ignored: DiffTest, itrace (use --no-itrace), a watchpoint, --commit-log, --func-profile or --pc-hist is enabled");
+    warned = true;
+  }
   for (   ;n > 0; n --) {
     if (sim_state.state != SIM_RUNNING) {
       if(sim_state.state == SIM_END) printf("下一条要执行的指令是----![信息待添加]\n");
@@ -197,15 +414,22 @@ void execute(uint64_t n){
     } else if (opcode == 0x67) {
       g_pc_pred_jalr_total++;
       if (commit_pred_pc == commit_pre_pc) g_pc_pred_jalr_correct++;
+    } else if (opcode == 0x6f) {
+      g_pc_pred_jal_total++;
+      if (commit_pred_pc == commit_pre_pc) g_pc_pred_jal_correct++;
     }
 
     npc_single_cycle();                             //再执行一次,该指令执行完毕.   
-    update_cpu_state();
-    IFDEF(CONFIG_ITRACE,   instr_trace(commit_pc));
-    IFDEF(CONFIG_DIFFTEST, difftest_step(commit_pc, commit_pc + 4));  
+    IFDEF(CONFIG_ITRACE,   if (itrace_enabled()) instr_trace(commit_pc, commit_instr));
+    if (commit_log_enabled()) commit_log_record(commit_pc, commit_instr, commit_pre_pc, commit_pred_pc, reg_ptr);
+    IFDEF(CONFIG_FUNC_TRACE, if (ftrace_enabled()) ftrace_commit(commit_pc, commit_instr, commit_pre_pc, commit_pred_pc));
+    if (pc_hist_enabled()) pc_hist_commit(commit_pc, commit_instr, commit_pre_pc, commit_pred_pc);
+    IFDEF(CONFIG_DIFFTEST, difftest_step(commit_pc, commit_pre_pc, commit_instr));  
+    if (unlikely(wp_enabled())) wp_check_and_update();
 
-    // Periodic progress report (for showing accuracy evolution)
-    pcpred_maybe_report_progress();
+    // interval window (--stats-interval)
+    stats_maybe_window();
+    if (g_nr_guest_inst == g_checkpoint_at && sim_state.state == SIM_RUNNING) checkpoint_save();
 
     // Stop at the requested commit window in batch mode.
     // Here, n==1 means this is the last iteration (because the for-loop will decrement n after this body).
@@ -214,11 +438,16 @@ void execute(uint64_t n){
       break;
     }
   }
+  // these commits were counted above: execute_fast() must only add what the
+  // model commits after this point
+  pcpred_rebase_hw();
 }
 
 
 void statistic() {
   npc_close_simulation();
+  ftrace_dump();
+  pc_hist_dump();
   #define NUMBERIC_FMT MUXDEF(CONFIG_TARGET_AM, "%", "%'") PRIu64
   Log("host time spent = " NUMBERIC_FMT " us", g_timer);
   Log("total guest instructions = " NUMBERIC_FMT, g_nr_guest_inst);
@@ -227,52 +456,8 @@ void statistic() {
   }else{
     Log("Finish running in less than 1 us and can not calculate the simulation frequency");
   }
-
-  Log("=== PC Prediction Statistics ===");
-  Log("[INFO] Total control-flow insts: %" PRIu64, g_pc_pred_total);
-  Log("[INFO] Correct predictions:      %" PRIu64, g_pc_pred_correct);
-  Log("[INFO] Mispredictions:           %" PRIu64, g_pc_pred_total - g_pc_pred_correct);
-  if (g_pc_pred_total > 0) {
-    double rate = (double)g_pc_pred_correct * 100.0 / (double)g_pc_pred_total;
-    Log("[INFO] Prediction success rate:  %.2f%%", rate);
-  } else {
-    Log("[INFO] Prediction success rate:  N/A (no control-flow inst executed)");
-  }
-
-  Log("=== PC Prediction Split (requested) ===");
-  Log("[INFO] B-type (opcode 0x63): total=%" PRIu64 ", correct=%" PRIu64 ", wrong=%" PRIu64,
-      g_pc_pred_b_total, g_pc_pred_b_correct, g_pc_pred_b_total - g_pc_pred_b_correct);
-  Log("[INFO] B-forward (imm_b>=0): total=%" PRIu64 ", correct=%" PRIu64 ", wrong=%" PRIu64,
-      g_pc_pred_b_fwd_total, g_pc_pred_b_fwd_correct, g_pc_pred_b_fwd_total - g_pc_pred_b_fwd_correct);
-  Log("[INFO] B-backward (imm_b<0): total=%" PRIu64 ", correct=%" PRIu64 ", wrong=%" PRIu64,
-      g_pc_pred_b_bwd_total, g_pc_pred_b_bwd_correct, g_pc_pred_b_bwd_total - g_pc_pred_b_bwd_correct);
-  if (g_pc_pred_b_total > 0) {
-    double rate_b = (double)g_pc_pred_b_correct * 100.0 / (double)g_pc_pred_b_total;
-    Log("[INFO] B-type success rate:      %.2f%%", rate_b);
-  } else {
-    Log("[INFO] B-type success rate:      N/A");
-  }
-  if (g_pc_pred_b_fwd_total > 0) {
-    double rate_bf = (double)g_pc_pred_b_fwd_correct * 100.0 / (double)g_pc_pred_b_fwd_total;
-    Log("[INFO] B-forward success rate:   %.2f%%", rate_bf);
-  } else {
-    Log("[INFO] B-forward success rate:   N/A");
-  }
-  if (g_pc_pred_b_bwd_total > 0) {
-    double rate_bb = (double)g_pc_pred_b_bwd_correct * 100.0 / (double)g_pc_pred_b_bwd_total;
-    Log("[INFO] B-backward success rate:  %.2f%%", rate_bb);
-  } else {
-    Log("[INFO] B-backward success rate:  N/A");
-  }
-
-  Log("[INFO] JALR/RET (opcode 0x67): total=%" PRIu64 ", correct=%" PRIu64 ", wrong=%" PRIu64,
-      g_pc_pred_jalr_total, g_pc_pred_jalr_correct, g_pc_pred_jalr_total - g_pc_pred_jalr_correct);
-  if (g_pc_pred_jalr_total > 0) {
-    double rate_jalr = (double)g_pc_pred_jalr_correct * 100.0 / (double)g_pc_pred_jalr_total;
-    Log("[INFO] JALR/RET success rate:    %.2f%%", rate_jalr);
-  } else {
-    Log("[INFO] JALR/RET success rate:    N/A");
-  }
+  host_prof_dump(g_timer);
+  stats_dump();
 }
 
 
@@ -288,7 +473,11 @@ void cpu_exec(uint64_t n) {
     default: sim_state.state = SIM_RUNNING;
   }
   uint64_t timer_start = get_time();
-  execute(n); 
+  {
+    HOST_PHASE(HOST_HARNESS);
+    execute(n); 
+    IFDEF(CONFIG_DIFFTEST, difftest_sync());
+  }
 
   uint64_t timer_end = get_time();
   g_timer += timer_end - timer_start;
@@ -297,6 +486,11 @@ void cpu_exec(uint64_t n) {
     case SIM_RUNNING: sim_state.state = SIM_STOP; break;
     case SIM_END: 
     case SIM_ABORT:
+      IFDEF(CONFIG_DIFFTEST, difftest_check_mem("end of program"));
+      if (sim_state.state == SIM_ABORT || sim_state.halt_ret != 0) {
+        iringbuf_dump();
+        wave_ring_dump("HIT BAD TRAP");
+      }
       Log("SIM: %s at pc = [pc值信息有误,待修复]" FMT_WORD,
           (sim_state.state == SIM_ABORT ? ANSI_FMT("ABORT", ANSI_FG_RED) :
           (sim_state.halt_ret == 0 ? ANSI_FMT("HIT GOOD TRAP", ANSI_FG_GREEN) :
@@ -0,0 +1,138 @@
+#include <common.h>
+#include <defs.h>
+#include <debug.h>
+#include <simulator_state.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <verilated_save.h>
+
+// Crash-triggered waveform (--wave-ring=K).
+// Nothing is dumped while running. Every K cycles the model is serialized into
+// one of two in-memory files, and guest stores are logged with the data they
+// overwrite. On a crash, memory is rolled back to the older snapshot (K..2K
+// cycles ago), the model is restored from it and re-run to the crash cycle with
+// FST dumping on, then the crash state is put back.
+#ifdef CONFIG_NPC_OPEN_SIM
+extern NPC_LOCAL SIMState sim_state;
+NPC_LOCAL bool g_wave_ring_on = false;
+static NPC_LOCAL bool replaying = false;
+
+typedef struct { paddr_t addr; int len; word_t old; } MemUndo;
+typedef struct {
+  int fd;
+  bool valid;
+  uint64_t clk;
+  std::vector<MemUndo> undo;  // stores made after this snapshot
+} Snapshot;
+static NPC_LOCAL Snapshot snap[2];
+static NPC_LOCAL int newest = 0;
+static NPC_LOCAL uint64_t ring_cycles = 0;
+static NPC_LOCAL const char *pending = NULL;
+
+static std::string fd_path(int fd) { return "/proc/self/fd/" + std::to_string(fd); }
+
+static int mem_file() {
+  int fd = memfd_create("npc-wave-ring", 0);
+  Assert(fd >= 0, "memfd_create failed");
+  return fd;
+}
+
+static void log_store(paddr_t addr, int len, word_t old) {
+  snap[newest].undo.push_back({addr, len, old});
+}
+
+static void save_to(int fd) {
+  VerilatedSave os;
+  os.open(fd_path(fd).c_str());
+  Assert(os.isOpen(), "Can not open the wave ring snapshot");
+  npc_serialize(os);
+  os.close();
+}
+
+static void restore_from(int fd) {
+  VerilatedRestore is;
+  is.open(fd_path(fd).c_str());
+  Assert(is.isOpen(), "Can not open the wave ring snapshot");
+  npc_deserialize(is);
+  is.close();
+}
+
+void wave_ring_init(uint64_t k) {
+  Assert(k > 0, "--wave-ring needs a positive cycle count");
+  for (int i = 0; i < 2; i ++) snap[i].fd = mem_file();
+  ring_cycles = k;
+  pmem_set_write_hook(log_store);
+  g_wave_ring_on = true;
+  Log("Wave ring: keeping the last %" PRIu64 " cycles for crash waveforms", k);
+}
+
+void wave_ring_dump(const char *why) {
+  if (!g_wave_ring_on || replaying) return;
+  const int older = newest ^ 1;
+  const int from = snap[older].valid ? older : newest;
+  if (!snap[from].valid) {
+    Log("Wave ring: no snapshot yet, no waveform for %s", why);
+    return;
+  }
+  const uint64_t crash_clk = npc_cycle_count();
+  const SIMState crash_state = sim_state;
+  int crash_fd = mem_file();
+  save_to(crash_fd);
+
+  pmem_set_write_hook(NULL);
+  for (int i = newest; ; i = older) {
+    auto &u = snap[i].undo;
+    for (auto it = u.rbegin(); it != u.rend(); ++ it) pmem_write(it->addr, it->len, it->old);
+    if (i == from) break;
+  }
+  restore_from(snap[from].fd);
+
+  replaying = true;
+  npc_wave_ctl(1);
+  while (npc_cycle_count() < crash_clk) npc_single_cycle();
+  npc_wave_ctl(0);
+  replaying = false;
+
+  restore_from(crash_fd);
+  close(crash_fd);
+  sim_state = crash_state;
+  Log("Wave ring: cycles [%" PRIu64 ", %" PRIu64 "] dumped for %s", snap[from].clk, crash_clk, why);
+}
+
+// Device side effects (serial output) happened in the original run already.
+bool wave_ring_replaying() { return replaying; }
+// A dump reaches at least this many cycles back (0: no wave ring).
+uint64_t wave_ring_depth() { return g_wave_ring_on ? ring_cycles : 0; }
+
+// Called from a DPI function: the model is in the middle of eval(), so the
+// replay has to wait for the end of the cycle (wave_ring_cycle).
+bool wave_ring_request(const char *why) {
+  if (!g_wave_ring_on) return false;
+  if (!replaying && pending == NULL) pending = why;
+  return true;
+}
+
+void wave_ring_cycle(uint64_t clk) {
+  if (replaying) return;
+  if (unlikely(pending)) {
+    wave_ring_dump(pending);
+    npc_close_simulation();
+    npc_exit(1);
+  }
+  if (!snap[newest].valid || clk - snap[newest].clk >= ring_cycles) {
+    newest ^= 1;
+    save_to(snap[newest].fd);
+    snap[newest].valid = true;
+    snap[newest].clk = clk;
+    snap[newest].undo.clear();
+  }
+}
+#else
+void wave_ring_init(uint64_t k) { Log("--wave-ring ignored: the model is built without --trace-fst (make debug)"); }
+void wave_ring_dump(const char *why) { }
+bool wave_ring_request(const char *why) { return false; }
+bool wave_ring_replaying() { return false; }
+uint64_t wave_ring_depth() { return 0; }
+#endif
@@ -0,0 +1,63 @@
+#include <common.h>
+#include <defs.h>
+#include <debug.h>
+#include <commit_log.h>
+
+// --commit-log=FILE: one delta/varint record per commit (format in commit_log.h),
+// buffered and written with fwrite when the buffer fills up. The buffer is
+// allocated by commit_log_open(), not thread-local (libnpc).
+#define COMMIT_LOG_BUF_SIZE (1 << 20)
+
+static NPC_LOCAL FILE *clog_fp = NULL;
+static NPC_LOCAL uint8_t *log_buf = NULL;
+static NPC_LOCAL uint8_t *log_p = NULL;
+static NPC_LOCAL CommitLogState log_state = {};
+static NPC_LOCAL uint64_t log_records = 0;
+
+bool commit_log_enabled() { return clog_fp != NULL; }
+
+static void commit_log_flush() {
+  if (log_p == log_buf) return;
+  size_t n = log_p - log_buf;
+  Assert(fwrite(log_buf, 1, n, clog_fp) == n, "Write to the commit log failed");
+  log_p = log_buf;
+}
+
+// registered with npc_atexit(), so the tail is also written on difftest/DPI error exits
+static void commit_log_close() {
+  if (clog_fp == NULL) return;
+  commit_log_flush();
+  fclose(clog_fp);
+  clog_fp = NULL;
+  free(log_buf);
+  Log("Commit log: %" PRIu64 " records", log_records);
+}
+
+void commit_log_open(const char *file) {
+  clog_fp = fopen(file, "wb");
+  Assert(clog_fp, "Can not open '%s'", file);
+  fwrite(COMMIT_LOG_MAGIC, 1, strlen(COMMIT_LOG_MAGIC), clog_fp);
+  log_buf = log_p = (uint8_t *)malloc(COMMIT_LOG_BUF_SIZE);
+  npc_atexit(commit_log_close);
+  Log("Commit log is written to %s", file);
+}
+
+// rd is written by everything except S/B-type stores and branches (and x0)
+static inline uint32_t instr_rd(uint32_t instr) {
+  uint32_t opcode = instr & 0x7f;
+  if (opcode == 0x23 || opcode == 0x63) return 0;
+  return (instr >> 7) & 0x1f;
+}
+
+void commit_log_record(word_t pc, uint32_t instr, word_t next_pc, word_t pred_pc, const word_t *gpr) {
+  CommitRecord r;
+  r.pc = pc;
+  r.instr = instr;
+  r.rd = instr_rd(instr);
+  r.value = r.rd ? gpr[r.rd] : 0;
+  r.next_pc = next_pc;
+  r.pred_pc = pred_pc;
+  if (unlikely(log_p + COMMIT_LOG_MAX_RECORD > log_buf + COMMIT_LOG_BUF_SIZE)) commit_log_flush();
+  log_p = commit_log_encode(&log_state, &r, log_p);
+  log_records ++;
+}
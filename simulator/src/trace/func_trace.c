@@ -0,0 +1,171 @@
+#include <common.h>
+#include <debug.h>
+#include <defs.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Function profiler (--func-profile=FILE, CONFIG_FUNC_TRACE).
+// Calls and returns are recognized at commit from the RISC-V calling
+// convention: JAL/JALR with rd = ra/t0 is a call, JALR x0 with rs1 = ra/t0 a
+// return, a jump with rd = x0 to the first instruction of another function a
+// tail call. A shadow call stack maps every commit to a node of the call tree;
+// each node counts its own instructions, cycles (since the previous commit),
+// mispredicted control-flow instructions and the cycles of the commit after
+// each misprediction (the refetch bubble).
+// At the end FILE gets the call tree as collapsed stacks weighted by cycles
+// (flamegraph.pl FILE > out.svg) and FILE.csv the per-function totals.
+#ifdef CONFIG_FUNC_TRACE
+typedef struct {
+  vaddr_t  func;     // start address of the function (symbol, or call target without symbols)
+  int      parent;
+  uint64_t inst, cycle, mispred, mispred_cycle;
+  std::unordered_map<vaddr_t, int> child;
+} CallNode;
+
+typedef struct {
+  int     node;
+  vaddr_t ret;       // where the matching return goes
+} Frame;
+
+static NPC_LOCAL const char *profile_file = NULL;
+static NPC_LOCAL std::vector<CallNode> nodes;
+static NPC_LOCAL std::unordered_map<vaddr_t, int> roots;
+static NPC_LOCAL std::vector<Frame> stack;
+static NPC_LOCAL uint64_t last_cycle = 0;
+static NPC_LOCAL bool last_mispred = false;
+
+bool ftrace_enabled() { return profile_file != NULL; }
+
+void ftrace_open(const char *file) {
+  profile_file = file;
+  if (symbol_count() == 0) Log("--func-profile: no symbols (--elf), functions are named by address");
+  Log("Function profile is written to %s", file);
+}
+
+static vaddr_t func_of(vaddr_t pc) {
+  const Symbol *s = symbol_lookup(pc);
+  return s ? s->addr : pc;
+}
+
+static int child_of(int parent, vaddr_t func) {
+  auto &m = parent >= 0 ? nodes[parent].child : roots;
+  auto it = m.find(func);
+  if (it != m.end()) return it->second;
+  nodes.push_back({func, parent, 0, 0, 0, 0, {}});
+  int id = nodes.size() - 1;
+  (parent >= 0 ? nodes[parent].child : roots)[func] = id;   // push_back may have moved m
+  return id;
+}
+
+static inline bool is_link(uint32_t r) { return r == 1 || r == 5; }
+
+void ftrace_commit(vaddr_t pc, uint32_t instr, vaddr_t next_pc, vaddr_t pred_pc) {
+  if (unlikely(stack.empty())) {
+    stack.push_back({child_of(-1, func_of(pc)), 0});
+    last_cycle = npc_cycle_count();
+  }
+  // this commit's cycles belong to the function it executes in
+  const uint64_t now = npc_cycle_count();
+  CallNode *n = &nodes[stack.back().node];
+  n->inst ++;
+  n->cycle += now - last_cycle;
+  if (last_mispred) n->mispred_cycle += now - last_cycle;
+  last_cycle = now;
+
+  const uint32_t opcode = instr & 0x7f;
+  if (opcode != 0x6f && opcode != 0x67 && opcode != 0x63) { last_mispred = false; return; }
+  last_mispred = (pred_pc != next_pc);
+  n->mispred += last_mispred;
+  if (opcode == 0x63) return;
+
+  const uint32_t rd = (instr >> 7) & 0x1f, rs1 = (instr >> 15) & 0x1f;
+  if (is_link(rd)) {
+    stack.push_back({child_of(stack.back().node, func_of(next_pc)), pc + 4});
+  } else if (rd == 0 && opcode == 0x67 && is_link(rs1)) {
+    // unwind to the frame this returns to (a longjmp skips several)
+    size_t i = stack.size();
+    while (i > 1 && stack[i - 1].ret != next_pc) i --;
+    if (i > 1) stack.resize(i - 1);
+    else if (stack.size() > 1) stack.pop_back();
+  } else if (rd == 0) {
+    const Symbol *s = symbol_lookup(next_pc);
+    if (s && s->addr == next_pc && next_pc != nodes[stack.back().node].func) {
+      Frame &top = stack.back();
+      top.node = child_of(nodes[top.node].parent, next_pc);
+    }
+  }
+}
+
+static std::string func_name(vaddr_t func) {
+  const Symbol *s = symbol_lookup(func);
+  if (s) return s->name;
+  char buf[16];
+  snprintf(buf, sizeof(buf), "0x%08x", func);
+  return buf;
+}
+
+void ftrace_dump() {
+  if (profile_file == NULL || nodes.empty()) return;
+  FILE *fp = fopen(profile_file, "w");
+  Assert(fp, "Can not open '%s'", profile_file);
+
+  // nodes are created after their parents, so one backward pass sums subtrees
+  std::vector<uint64_t> sub_inst(nodes.size()), sub_cycle(nodes.size());
+  for (size_t i = nodes.size(); i -- > 0; ) {
+    sub_inst[i] += nodes[i].inst;
+    sub_cycle[i] += nodes[i].cycle;
+    if (nodes[i].parent >= 0) {
+      sub_inst[nodes[i].parent] += sub_inst[i];
+      sub_cycle[nodes[i].parent] += sub_cycle[i];
+    }
+  }
+
+  typedef struct { uint64_t inst, cycle, incl_inst, incl_cycle, mispred, mispred_cycle; } FuncStat;
+  std::unordered_map<vaddr_t, FuncStat> funcs;
+  std::vector<std::string> path(nodes.size());
+  for (size_t i = 0; i < nodes.size(); i ++) {
+    const CallNode &n = nodes[i];
+    std::string name = func_name(n.func);
+    path[i] = n.parent >= 0 ? path[n.parent] + ";" + name : name;
+    if (n.cycle) fprintf(fp, "%s %" PRIu64 "\n", path[i].c_str(), n.cycle);
+
+    FuncStat &f = funcs[n.func];
+    f.inst += n.inst;
+    f.cycle += n.cycle;
+    f.mispred += n.mispred;
+    f.mispred_cycle += n.mispred_cycle;
+    // inclusive: only the outermost activation of a recursive function
+    bool nested = false;
+    for (int p = n.parent; p >= 0 && !nested; p = nodes[p].parent) nested = (nodes[p].func == n.func);
+    if (!nested) { f.incl_inst += sub_inst[i]; f.incl_cycle += sub_cycle[i]; }
+  }
+  fclose(fp);
+
+  std::vector<std::pair<vaddr_t, FuncStat>> sorted(funcs.begin(), funcs.end());
+  std::sort(sorted.begin(), sorted.end(), [](auto &a, auto &b) { return a.second.cycle > b.second.cycle; });
+  std::string csv = std::string(profile_file) + ".csv";
+  fp = fopen(csv.c_str(), "w");
+  Assert(fp, "Can not open '%s'", csv.c_str());
+  fprintf(fp, "function,addr,self_inst,self_cycles,incl_inst,incl_cycles,mispred,mispred_cycles\n");
+  for (auto &e : sorted) {
+    const FuncStat &f = e.second;
+    fprintf(fp, "%s,0x%08x,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+            func_name(e.first).c_str(), e.first, f.inst, f.cycle, f.incl_inst, f.incl_cycle, f.mispred, f.mispred_cycle);
+  }
+  fclose(fp);
+
+  Log("=== Function profile (%s, %s) ===", profile_file, csv.c_str());
+  Log("%-24s %12s %12s %12s %10s %12s", "function", "self cyc", "incl cyc", "self inst", "mispred", "mispred cyc");
+  for (size_t i = 0; i < sorted.size() && i < 20; i ++) {
+    const FuncStat &f = sorted[i].second;
+    Log("%-24s %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %10" PRIu64 " %12" PRIu64, func_name(sorted[i].first).c_str(),
+        f.cycle, f.incl_cycle, f.inst, f.mispred, f.mispred_cycle);
+  }
+}
+#else
+bool ftrace_enabled() { return false; }
+void ftrace_open(const char *file) { Log("--func-profile ignored: CONFIG_FUNC_TRACE is off"); }
+void ftrace_dump() { }
+#endif
@@ -1,27 +1,79 @@
-
 #include <cpu.h>
 #include <simulator_state.h>
 #include <common.h>
 #include <defs.h>
+#include <host_prof.h>
+#include <string>
+#include <unordered_map>
+
+// itrace 只往环形缓冲区里记 (pc, instr)，出错或 sdb "info i" 时才反汇编打印。
+// 反汇编结果按指令编码缓存；BRANCH/JAL 打印的是绝对目标地址，要连 pc 一起做 key。
+#ifdef CONFIG_ITRACE
+static_assert((CONFIG_IRINGBUF_SIZE & (CONFIG_IRINGBUF_SIZE - 1)) == 0,
+              "CONFIG_IRINGBUF_SIZE must be a power of 2");
+
+typedef struct {
+    uint64_t seq;     // g_nr_guest_inst of this commit
+    word_t   pc;
+    uint32_t instr;
+} IRingEntry;
+
+extern NPC_LOCAL uint64_t g_nr_guest_inst;
+
+static NPC_LOCAL IRingEntry iringbuf[CONFIG_IRINGBUF_SIZE];
+static NPC_LOCAL uint64_t   iring_count = 0;   // 记录过的指令总数，下一个位置是 count % SIZE
+static NPC_LOCAL bool       itrace_on = true;  // --no-itrace 关掉, --fast 才能生效
 
-void instr_trace(word_t pc) {
-    Decode s;
-    s.pc = pc;
-    s.inst_val = pmem_read(pc, 4);
-    char *p = s.logbuf;
-    p += snprintf(p, sizeof(s.logbuf), FMT_WORD ":", s.pc);
-    int ilen = 4;
-    int i;
-    uint8_t *inst = (uint8_t *)&s.inst_val;
-    for (i = ilen - 1; i >= 0; i --) {
-        p += snprintf(p, 4, " %02x", inst[i]);
+void itrace_disable() { itrace_on = false; }
+bool itrace_enabled() { return itrace_on; }
+
+void instr_trace(word_t pc, uint32_t instr) {
+    HOST_PHASE(HOST_ITRACE);
+    IRingEntry *e = &iringbuf[iring_count++ % CONFIG_IRINGBUF_SIZE];
+    e->seq = g_nr_guest_inst;
+    e->pc = pc;
+    e->instr = instr;
+}
+
+static const char *disasm_cached(word_t pc, uint32_t instr) {
+    static NPC_LOCAL std::unordered_map<uint64_t, std::string> cache;
+    const uint32_t opcode = instr & 0x7f;
+    const uint64_t key = (opcode == 0x63 || opcode == 0x6f) ? ((uint64_t)pc << 32 | instr) : instr;
+    auto it = cache.find(key);
+    if (it == cache.end()) {
+        char buf[96];
+        disassemble(buf, sizeof(buf), pc, (uint8_t *)&instr, 4);
+        it = cache.emplace(key, buf).first;
     }
-    int ilen_max = MUXDEF(CONFIG_ISA_x86, 8, 4);
-    int space_len = ilen_max - ilen;
-    if (space_len < 0) space_len = 0;
-    space_len = space_len * 3 + 1;
-    memset(p, ' ', space_len);
-    p += space_len;
-    disassemble(p, s.logbuf + sizeof(s.logbuf) - p, s.pc, (uint8_t *)&s.inst_val, ilen);
-    printf("%s\n",s.logbuf);
-}
\ No newline at end of file
+    return it->second.c_str();
+}
+
+// mark: the commit (g_nr_guest_inst) to point at, the last one by default.
+// DiffTest reports a mismatch some commits after it happened and passes the bad one.
+void iringbuf_dump_at(uint64_t mark) {
+    uint64_t n = iring_count < CONFIG_IRINGBUF_SIZE ? iring_count : CONFIG_IRINGBUF_SIZE;
+    printf("最近提交的 %" PRIu64 " 条指令 (共 %" PRIu64 " 条):\n", n, iring_count);
+    bool marked = false;
+    for (uint64_t i = iring_count - n; i < iring_count; i ++) {
+        const IRingEntry *e = &iringbuf[i % CONFIG_IRINGBUF_SIZE];
+        const uint8_t *b = (const uint8_t *)&e->instr;
+        const Symbol *s = symbol_lookup(e->pc);
+        const bool here = (e->seq == mark);
+        marked |= here;
+        printf("%s" FMT_WORD ": %02x %02x %02x %02x  %-32s", here ? " --> " : "     ",
+               e->pc, b[3], b[2], b[1], b[0], disasm_cached(e->pc, e->instr));
+        if (s) printf("  <%s+0x%x>", s->name, e->pc - s->addr);
+        printf("\n");
+    }
+    if (!marked && n > 0) printf("第 %" PRIu64 " 条提交的指令已经不在上面的 %" PRIu64 " 条里\n", mark, n);
+}
+
+void iringbuf_dump() {
+    iringbuf_dump_at(iring_count ? iringbuf[(iring_count - 1) % CONFIG_IRINGBUF_SIZE].seq : 0);
+}
+#else
+void itrace_disable() { }
+bool itrace_enabled() { return false; }
+void iringbuf_dump_at(uint64_t mark) { }
+void iringbuf_dump() { }
+#endif
@@ -0,0 +1,113 @@
+#include <common.h>
+#include <debug.h>
+#include <defs.h>
+#include <algorithm>
+#include <vector>
+
+// Per-PC hot spots (--pc-hist=FILE): for every committed pc, how often it
+// committed and how many cycles passed since the previous commit. Cycles
+// beyond the first are stall cycles: load-use and cache misses, divides,
+// refetch after a misprediction (charged to the instruction after the branch).
+// The table is open addressing on the pc, so a commit is one probe in the
+// common case. At the end FILE gets every pc sorted by stall cycles, with the
+// disassembly and the function it is in.
+typedef struct {
+  vaddr_t  pc;       // 0: empty slot
+  uint32_t instr;
+  uint64_t count, cycle, mispred;
+} PCStat;
+
+static NPC_LOCAL const char *hist_file = NULL;
+static NPC_LOCAL PCStat  *table = NULL;
+static NPC_LOCAL uint32_t table_mask = 0;
+static NPC_LOCAL uint32_t table_used = 0;
+static NPC_LOCAL uint64_t last_cycle = 0;
+
+bool pc_hist_enabled() { return hist_file != NULL; }
+
+void pc_hist_open(const char *file) {
+  hist_file = file;
+  table_mask = (1 << 16) - 1;
+  table = (PCStat *)calloc(table_mask + 1, sizeof(PCStat));
+  last_cycle = npc_cycle_count();
+  Log("Per-PC histogram is written to %s", file);
+}
+
+static inline uint32_t slot_of(vaddr_t pc) { return ((pc >> 2) * 0x9e3779b1u) >> 8; }
+
+static PCStat *insert_slow(vaddr_t pc);
+
+static inline PCStat *lookup(vaddr_t pc) {
+  for (uint32_t i = slot_of(pc); ; i ++) {
+    PCStat *e = &table[i & table_mask];
+    if (likely(e->pc == pc)) return e;
+    if (e->pc == 0) return insert_slow(pc);
+  }
+}
+
+// new pc: claim a slot, grow at 1/2 load
+static PCStat *insert_slow(vaddr_t pc) {
+  if (table_used * 2 >= table_mask) {
+    PCStat *old = table;
+    const uint32_t old_size = table_mask + 1;
+    table_mask = old_size * 2 - 1;
+    table = (PCStat *)calloc(table_mask + 1, sizeof(PCStat));
+    for (uint32_t i = 0; i < old_size; i ++) {
+      if (old[i].pc == 0) continue;
+      uint32_t j = slot_of(old[i].pc);
+      while (table[j & table_mask].pc != 0) j ++;
+      table[j & table_mask] = old[i];
+    }
+    free(old);
+  }
+  uint32_t i = slot_of(pc);
+  while (table[i & table_mask].pc != 0) i ++;
+  PCStat *e = &table[i & table_mask];
+  e->pc = pc;
+  table_used ++;
+  return e;
+}
+
+void pc_hist_commit(vaddr_t pc, uint32_t instr, vaddr_t next_pc, vaddr_t pred_pc) {
+  const uint64_t now = npc_cycle_count();
+  PCStat *e = lookup(pc);
+  e->instr = instr;
+  e->count ++;
+  e->cycle += now - last_cycle;
+  e->mispred += (pred_pc != next_pc);
+  last_cycle = now;
+}
+
+void pc_hist_dump() {
+  if (hist_file == NULL || table_used == 0) return;
+  std::vector<const PCStat *> pcs;
+  uint64_t total_stall = 0;
+  for (uint32_t i = 0; i <= table_mask; i ++) {
+    if (table[i].pc == 0) continue;
+    pcs.push_back(&table[i]);
+    total_stall += table[i].cycle - table[i].count;
+  }
+  std::sort(pcs.begin(), pcs.end(), [](const PCStat *a, const PCStat *b) {
+    return a->cycle - a->count > b->cycle - b->count;
+  });
+
+  FILE *fp = fopen(hist_file, "w");
+  Assert(fp, "Can not open '%s'", hist_file);
+  fprintf(fp, "# %u pcs, %" PRIu64 " stall cycles (cycles beyond 1 per commit)\n", table_used, total_stall);
+  fprintf(fp, "#      stall  stall%%       count      cycles    CPI    mispred  pc          function / instruction\n");
+  for (const PCStat *e : pcs) {
+    char asm_buf[96] = "";
+    uint32_t instr = e->instr;
+    IFDEF(CONFIG_ITRACE, disassemble(asm_buf, sizeof(asm_buf), e->pc, (uint8_t *)&instr, 4));
+    const Symbol *s = symbol_lookup(e->pc);
+    char where[64] = "";
+    if (s) snprintf(where, sizeof(where), "<%s+0x%x>", s->name, e->pc - s->addr);
+    const uint64_t stall = e->cycle - e->count;
+    fprintf(fp, "%12" PRIu64 " %6.2f%% %11" PRIu64 " %11" PRIu64 " %6.2f %10" PRIu64 "  " FMT_WORD "  %-24s %08x  %s\n",
+            stall, total_stall ? stall * 100.0 / total_stall : 0.0, e->count, e->cycle,
+            (double)e->cycle / e->count, e->mispred, e->pc, where, e->instr, asm_buf);
+  }
+  fclose(fp);
+  Log("Per-PC histogram: %u pcs, %" PRIu64 " stall cycles, top stall pc " FMT_WORD " (%s)",
+      table_used, total_stall, pcs[0]->pc, hist_file);
+}
@@ -25,17 +25,24 @@
 #error Please use LLVM with major version >= 11
 #endif
 
+#include <mutex>
+#include <macro.h>   // NPC_LOCAL
+
 using namespace llvm;
 
-static llvm::MCDisassembler *gDisassembler = nullptr;
-static llvm::MCSubtargetInfo *gSTI = nullptr;
-static llvm::MCInstPrinter *gIP = nullptr;
+static NPC_LOCAL llvm::MCDisassembler *gDisassembler = nullptr;
+static NPC_LOCAL llvm::MCSubtargetInfo *gSTI = nullptr;
+static NPC_LOCAL llvm::MCInstPrinter *gIP = nullptr;
 
+// the target registry is process-wide, the disassembler is per instance (libnpc)
 void init_disasm(const char *triple) {
-  llvm::InitializeAllTargetInfos();
-  llvm::InitializeAllTargetMCs();
-  llvm::InitializeAllAsmParsers();
-  llvm::InitializeAllDisassemblers();
+  static std::once_flag registered;
+  std::call_once(registered, [] {
+    llvm::InitializeAllTargetInfos();
+    llvm::InitializeAllTargetMCs();
+    llvm::InitializeAllAsmParsers();
+    llvm::InitializeAllDisassemblers();
+  });
 
   std::string errstr;
   std::string gTriple(triple);
@@ -0,0 +1,33 @@
+#include <common.h>
+#include <debug.h>
+#include <host_prof.h>
+
+extern NPC_LOCAL uint64_t g_nr_guest_inst;
+uint64_t npc_cycle_count();
+
+const char *const host_phase_name[NR_HOST_PHASE] = {"eval", "dpi_mem", "cpu_state", "difftest", "itrace", "wave", "harness"};
+NPC_LOCAL bool     g_host_prof = false;
+NPC_LOCAL uint64_t g_host_tsc[NR_HOST_PHASE] = {};
+NPC_LOCAL uint64_t g_host_nested = 0;
+
+// parse_args time, the log is not open yet
+void host_prof_enable() { g_host_prof = true; }
+
+// host_us: wall time of the same cpu_exec() calls (g_timer), converts ticks to time.
+// KIPS/KCPS of a phase: the speed if the simulator spent time only in that phase.
+void host_prof_dump(uint64_t host_us) {
+  if (!g_host_prof) return;
+  uint64_t total = 0;
+  for (int i = 0; i < NR_HOST_PHASE; i ++) total += g_host_tsc[i];
+  if (total == 0 || host_us == 0) return;
+  const double tick_us = (double)host_us / total;
+  const uint64_t inst = g_nr_guest_inst, cycle = npc_cycle_count();
+  Log("=== Host profile (%.1f ms, %.0f ticks/us) ===", host_us / 1000.0, 1 / tick_us);
+  Log("%-10s %12s %7s %12s %12s", "phase", "ms", "share", "KIPS", "KCPS");
+  for (int i = 0; i <= NR_HOST_PHASE; i ++) {
+    const uint64_t t = i < NR_HOST_PHASE ? g_host_tsc[i] : total;
+    const double us = t * tick_us;
+    Log("%-10s %12.1f %6.2f%% %12.1f %12.1f", i < NR_HOST_PHASE ? host_phase_name[i] : "total",
+        us / 1000.0, t * 100.0 / total, us > 0 ? inst * 1000.0 / us : 0.0, us > 0 ? cycle * 1000.0 / us : 0.0);
+  }
+}
@@ -1,9 +1,14 @@
 #include <common.h>
 #include <debug.h>
 
-extern uint64_t g_nr_guest_inst;
+extern NPC_LOCAL uint64_t g_nr_guest_inst;
 
-FILE *log_fp = NULL;
+NPC_LOCAL FILE *log_fp = NULL;
+
+static void close_log() {
+  fclose(log_fp);
+  log_fp = stdout;
+}
 
 void init_log(const char *log_file) {
   log_fp = stdout;
@@ -11,6 +16,7 @@ void init_log(const char *log_file) {
     FILE *fp = fopen(log_file, "w");
     Assert(fp, "Can not open '%s'", log_file);
     log_fp = fp;
+    npc_atexit(close_log);
   }
   Log("Log is written to %s", log_file ? log_file : "stdout");
 }
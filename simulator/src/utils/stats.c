@@ -0,0 +1,208 @@
+#include <common.h>
+#include <debug.h>
+#include <defs.h>
+#include <verilated_save.h>
+#include <cmath>
+#include <string>
+#include <vector>
+
+extern NPC_LOCAL uint64_t g_nr_guest_inst;
+
+// Statistics registry. Every subsystem keeps its own uint64_t counters and
+// registers them once by name (stat_scalar/stat_hist); formulas (stat_ratio,
+// stat_diff) are computed from them. The registry then does the rest for all
+// of them: the measured window (values since stats_begin(), i.e. after
+// --warmup), interval windows every --stats-interval commits, the table at
+// exit, checkpoints, and --stats=FILE (JSON, or CSV when FILE ends in .csv).
+typedef struct {
+  std::string name;
+  const char *desc;
+  uint64_t   *counter;   // NULL: formula
+  char        op;        // formula: '/' (a / b * scale) or '-' (a - b)
+  int         a, b;
+  double      scale;
+} Stat;
+
+static NPC_LOCAL std::vector<Stat> stats;
+static NPC_LOCAL std::vector<uint64_t> base;   // counter values at stats_begin()
+static NPC_LOCAL std::vector<uint64_t> last;   // counter values at the previous interval window
+static NPC_LOCAL uint64_t stats_interval_n = 0;
+static NPC_LOCAL const char *stats_file = NULL;
+static NPC_LOCAL FILE *stats_fp = NULL;
+static NPC_LOCAL bool stats_csv = false;
+static NPC_LOCAL uint64_t nr_window = 0;
+
+static int add(const std::string &name, const char *desc, uint64_t *counter) {
+  for (const Stat &s : stats) Assert(s.name != name, "stat '%s' is registered twice", name.c_str());
+  stats.push_back({name, desc, counter, 0, 0, 0, 0});
+  base.push_back(counter ? *counter : 0);
+  last.push_back(counter ? *counter : 0);
+  return stats.size() - 1;
+}
+
+static int find(const char *name) {
+  for (size_t i = 0; i < stats.size(); i ++) {
+    if (stats[i].name == name) return i;
+  }
+  panic("stat '%s' is not registered", name);
+  return -1;
+}
+
+void stat_scalar(const char *name, uint64_t *counter, const char *desc) { add(name, desc, counter); }
+
+// n buckets named NAME.LABEL (NAME.0, NAME.1, ... without labels)
+void stat_hist(const char *name, uint64_t *bucket, int n, const char *const *label, const char *desc) {
+  for (int i = 0; i < n; i ++) {
+    add(std::string(name) + "." + (label ? label[i] : std::to_string(i)), desc, &bucket[i]);
+  }
+}
+
+void stat_ratio(const char *name, const char *num, const char *den, double scale, const char *desc) {
+  int id = add(name, desc, NULL);
+  stats[id].op = '/';
+  stats[id].a = find(num);
+  stats[id].b = find(den);
+  stats[id].scale = scale;
+}
+
+void stat_diff(const char *name, const char *a, const char *b, const char *desc) {
+  int id = add(name, desc, NULL);
+  stats[id].op = '-';
+  stats[id].a = find(a);
+  stats[id].b = find(b);
+}
+
+void stats_set_interval(uint64_t n) { stats_interval_n = n; }
+uint64_t stats_interval() { return stats_interval_n; }
+
+void stats_begin() {
+  for (size_t i = 0; i < stats.size(); i ++) {
+    if (stats[i].counter) base[i] = last[i] = *stats[i].counter;
+  }
+}
+
+// value of stat i over the window that started at ref
+static int64_t count(size_t i, const std::vector<uint64_t> &ref) {
+  const Stat &s = stats[i];
+  if (s.counter) return *s.counter - ref[i];
+  if (s.op == '-') return count(s.a, ref) - count(s.b, ref);
+  return 0;   // a ratio is not a count
+}
+
+static double ratio(size_t i, const std::vector<uint64_t> &ref) {
+  const Stat &s = stats[i];
+  const double a = stats[s.a].op == '/' ? ratio(s.a, ref) : count(s.a, ref);
+  const double b = stats[s.b].op == '/' ? ratio(s.b, ref) : count(s.b, ref);
+  return a / b * s.scale;
+}
+
+// x / 0 prints undef
+static void format(char *buf, size_t len, size_t i, const std::vector<uint64_t> &ref, const char *undef) {
+  if (stats[i].op != '/') { snprintf(buf, len, "%" PRId64, count(i, ref)); return; }
+  const double v = ratio(i, ref);
+  if (std::isfinite(v)) snprintf(buf, len, "%.6g", v);
+  else snprintf(buf, len, "%s", undef);
+}
+
+static void write_record(const char *kind, const std::vector<uint64_t> &ref) {
+  const uint64_t commit = g_nr_guest_inst, cycle = npc_cycle_count();
+  char buf[32];
+  if (stats_csv) {
+    fprintf(stats_fp, "%s,%" PRIu64 ",%" PRIu64, kind, commit, cycle);
+    for (size_t i = 0; i < stats.size(); i ++) {
+      format(buf, sizeof(buf), i, ref, "");
+      fprintf(stats_fp, ",%s", buf);
+    }
+    fprintf(stats_fp, "\n");
+    return;
+  }
+  fprintf(stats_fp, "{\"commit\": %" PRIu64 ", \"cycle\": %" PRIu64 ", \"stats\": {", commit, cycle);
+  for (size_t i = 0; i < stats.size(); i ++) {
+    format(buf, sizeof(buf), i, ref, "null");
+    fprintf(stats_fp, "%s\"%s\": %s", i ? ", " : "", stats[i].name.c_str(), buf);
+  }
+  fprintf(stats_fp, "}}");
+}
+
+void stats_open(const char *file) {
+  stats_file = file;
+  stats_fp = fopen(file, "w");
+  Assert(stats_fp, "Can not open '%s'", file);
+  const size_t len = strlen(file);
+  stats_csv = len >= 4 && strcmp(file + len - 4, ".csv") == 0;
+  if (stats_csv) {
+    fprintf(stats_fp, "kind,commit,cycle");
+    for (const Stat &s : stats) fprintf(stats_fp, ",%s", s.name.c_str());
+    fprintf(stats_fp, "\n");
+  } else {
+    fprintf(stats_fp, "{\n\"intervals\": [");
+  }
+  Log("Statistics are written to %s", file);
+}
+
+// Called every --stats-interval commits: one record with the values since the
+// previous window, or a [STATS] log line without --stats.
+void stats_window() {
+  if (stats_fp) {
+    if (!stats_csv) fprintf(stats_fp, "%s\n  ", nr_window ? "," : "");
+    write_record("window", last);
+  } else {
+    std::string line;
+    char buf[32];
+    for (size_t i = 0; i < stats.size(); i ++) {
+      format(buf, sizeof(buf), i, last, "N/A");
+      line += " " + stats[i].name + "=" + buf;
+    }
+    Log("[STATS] commit=%" PRIu64 "%s", g_nr_guest_inst, line.c_str());
+  }
+  for (size_t i = 0; i < stats.size(); i ++) {
+    if (stats[i].counter) last[i] = *stats[i].counter;
+  }
+  nr_window ++;
+}
+
+// the measured window: table to the log, final record to --stats
+void stats_dump() {
+  Log("=== Statistics (%zu, measured window) ===", stats.size());
+  char buf[32];
+  for (size_t i = 0; i < stats.size(); i ++) {
+    format(buf, sizeof(buf), i, base, "N/A");
+    Log("[STAT] %-28s %16s  # %s", stats[i].name.c_str(), buf, stats[i].desc);
+  }
+  if (stats_fp == NULL) return;
+  if (!stats_csv) fprintf(stats_fp, "%s],\n\"final\": ", nr_window ? "\n" : "");
+  write_record("final", base);
+  if (!stats_csv) fprintf(stats_fp, "\n}\n");
+  fclose(stats_fp);
+  stats_fp = NULL;
+  Log("Statistics: %" PRIu64 " windows and the final values in %s", nr_window, stats_file);
+}
+
+// the counters themselves, and where the measured and the interval window
+// start. The hash of the names catches a checkpoint from a build that
+// registers different statistics.
+static uint64_t layout_hash() {
+  uint64_t h = 0xcbf29ce484222325ull;
+  for (const Stat &s : stats) {
+    for (char c : s.name) h = (h ^ (uint8_t)c) * 0x100000001b3ull;
+    h = (h ^ '\n') * 0x100000001b3ull;
+  }
+  return h;
+}
+
+void stats_serialize(VerilatedSerialize &os) {
+  uint64_t h = layout_hash();
+  os << h;
+  for (size_t i = 0; i < stats.size(); i ++) {
+    if (stats[i].counter) os << *stats[i].counter << base[i] << last[i];
+  }
+}
+
+void stats_deserialize(VerilatedDeserialize &is) {
+  uint64_t h = 0;
+  is >> h;
+  Assert(h == layout_hash(), "The checkpoint was saved by a build with different statistics");
+  for (size_t i = 0; i < stats.size(); i ++) {
+    if (stats[i].counter) is >> *stats[i].counter >> base[i] >> last[i];
+  }
+}
@@ -7,7 +7,7 @@
 IFDEF(CONFIG_TIMER_CLOCK_GETTIME, static_assert(CLOCKS_PER_SEC == 1000000, "CLOCKS_PER_SEC != 1000000"));
 IFDEF(CONFIG_TIMER_CLOCK_GETTIME, static_assert(sizeof(clock_t) == 8, "sizeof(clock_t) != 8"));
 
-static uint64_t boot_time = 0;
+static NPC_LOCAL uint64_t boot_time = 0;
 static uint64_t get_time_internal() {
   struct timeval now;
   gettimeofday(&now, NULL);
@@ -0,0 +1,84 @@
+// npc-pool: run many simulations in one process with libnpc (include/libnpc.h)
+//
+//   npc-pool [-j N] JOBS
+//
+// JOBS has one simulator command line per line, the options and IMAGE as for
+// build/*/CPU (no shell quoting, '#' starts a comment). N workers (default:
+// the number of CPUs) take the next line and run it as a libnpc instance.
+// Instances of the same image share its page cache pages, the image is mapped
+// copy-on-write. Prints one line per job, the exit code is 1 if any failed.
+#include <libnpc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Job {
+  std::string line;
+  std::vector<std::string> args;
+  int status = -1;
+  double seconds = 0;
+};
+
+static std::vector<Job> read_jobs(const char *file) {
+  std::ifstream in(file);
+  if (!in) { perror(file); exit(2); }
+  std::vector<Job> jobs;
+  for (std::string line; std::getline(in, line); ) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream ss(line);
+    Job j;
+    j.args.push_back("npc");
+    for (std::string a; ss >> a; ) j.args.push_back(a);
+    if (j.args.size() == 1) continue;
+    j.line = line.substr(line.find_first_not_of(" \t"));
+    jobs.push_back(j);
+  }
+  return jobs;
+}
+
+int main(int argc, char **argv) {
+  unsigned nr_worker = std::thread::hardware_concurrency();
+  int o;
+  while ((o = getopt(argc, argv, "j:")) != -1) {
+    if (o == 'j') nr_worker = atoi(optarg);
+    else { fprintf(stderr, "usage: %s [-j N] JOBS\n", argv[0]); return 2; }
+  }
+  if (optind + 1 != argc) { fprintf(stderr, "usage: %s [-j N] JOBS\n", argv[0]); return 2; }
+  std::vector<Job> jobs = read_jobs(argv[optind]);
+  if (nr_worker == 0) nr_worker = 1;
+  if (nr_worker > jobs.size()) nr_worker = jobs.size();
+
+  std::atomic<size_t> next{0};
+  std::mutex print_lock;
+  auto worker = [&] {
+    for (size_t i; (i = next.fetch_add(1)) < jobs.size(); ) {
+      Job &j = jobs[i];
+      std::vector<char *> av;
+      for (std::string &a : j.args) av.push_back(&a[0]);
+      const auto start = std::chrono::steady_clock::now();
+      j.status = libnpc_run(av.size(), av.data());
+      j.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      std::lock_guard<std::mutex> guard(print_lock);
+      fprintf(stderr, "[npc-pool] %s %8.2fs  %s\n", j.status == 0 ? "PASS" : "FAIL", j.seconds, j.line.c_str());
+    }
+  };
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < nr_worker; i ++) workers.emplace_back(worker);
+  for (std::thread &t : workers) t.join();
+
+  int failed = 0;
+  for (const Job &j : jobs) failed += (j.status != 0);
+  fprintf(stderr, "[npc-pool] %zu jobs, %d failed, %u workers, %.2fs\n", jobs.size(), failed, nr_worker,
+          std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,219 @@
+// npc-tracetool: query and compare --commit-log files (format in include/utils/commit_log.h)
+//
+//   npc-tracetool stat   LOG [--top=N]
+//   npc-tracetool filter LOG [--from=I] [--to=I] [--pc=LO[:HI]] [--opcode=OP] [--rd=N] [--mispred]
+//   npc-tracetool diff   LOG_A LOG_B [--max=N]
+#include <commit_log.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct LogReader {
+  const uint8_t *base = nullptr, *p = nullptr, *end = nullptr;
+  size_t size = 0;
+  CommitLogState state = {};
+  uint64_t index = 0;   // index of the next record
+  const char *file;
+
+  explicit LogReader(const char *f) : file(f) {
+    int fd = open(f, O_RDONLY);
+    if (fd < 0) { perror(f); exit(2); }
+    struct stat st;
+    fstat(fd, &st);
+    size = st.st_size;
+    const size_t magic_len = strlen(COMMIT_LOG_MAGIC);
+    if (size < magic_len) { fprintf(stderr, "%s: not a commit log\n", f); exit(2); }
+    void *m = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) { perror("mmap"); exit(2); }
+    madvise(m, size, MADV_SEQUENTIAL);
+    base = (const uint8_t *)m;
+    if (memcmp(base, COMMIT_LOG_MAGIC, magic_len) != 0) { fprintf(stderr, "%s: not a commit log\n", f); exit(2); }
+    p = base + magic_len;
+    end = base + size;
+  }
+  ~LogReader() { munmap((void *)base, size); }
+
+  bool next(CommitRecord *r) {
+    if (p == end) return false;
+    const uint8_t *q = commit_log_decode(&state, p, end, r);
+    if (q == nullptr) {
+      fprintf(stderr, "%s: truncated record %" PRIu64 " at byte %zu\n", file, index, (size_t)(p - base));
+      p = end;
+      return false;
+    }
+    p = q;
+    index ++;
+    return true;
+  }
+};
+
+static const char *arg_value(const char *arg, const char *name) {
+  size_t n = strlen(name);
+  return (strncmp(arg, name, n) == 0 && arg[n] == '=') ? arg + n + 1 : nullptr;
+}
+
+static void print_record(uint64_t idx, const CommitRecord &r) {
+  printf("%10" PRIu64 "  pc=0x%08x  instr=0x%08x", idx, r.pc, r.instr);
+  if (r.rd) printf("  x%-2u=0x%08x", r.rd, r.value);
+  else      printf("                 ");
+  printf("  next=0x%08x", r.next_pc);
+  if (r.pred_pc != r.next_pc) printf("  pred=0x%08x MISPRED", r.pred_pc);
+  printf("\n");
+}
+
+static bool is_control_flow(uint32_t instr) {
+  uint32_t op = instr & 0x7f;
+  return op == 0x63 || op == 0x6f || op == 0x67;
+}
+
+// ----------------------------------------------------------------- stat
+static int cmd_stat(int argc, char **argv) {
+  if (argc < 1) return -1;
+  size_t top = 10;
+  for (int i = 1; i < argc; i ++) {
+    if (const char *v = arg_value(argv[i], "--top")) top = strtoull(v, nullptr, 0);
+    else return -1;
+  }
+  LogReader in(argv[0]);
+  enum { B_FWD, B_BWD, JAL, JALR, NR_KIND };
+  static const char *kind_name[NR_KIND] = {"B-forward", "B-backward", "JAL", "JALR"};
+  uint64_t total[NR_KIND] = {}, correct[NR_KIND] = {};
+  std::unordered_map<uint32_t, uint64_t> op_count;
+  std::unordered_map<uint32_t, std::pair<uint64_t, uint64_t>> pc_miss;  // pc -> (executed, mispredicted)
+  CommitRecord r;
+  while (in.next(&r)) {
+    uint32_t op = r.instr & 0x7f;
+    op_count[op] ++;
+    if (!is_control_flow(r.instr)) continue;
+    int k = op == 0x6f ? JAL : op == 0x67 ? JALR : (r.instr >> 31) ? B_BWD : B_FWD;
+    bool ok = (r.pred_pc == r.next_pc);
+    total[k] ++;
+    correct[k] += ok;
+    auto &e = pc_miss[r.pc];
+    e.first ++;
+    e.second += !ok;
+  }
+
+  printf("records: %" PRIu64 " (%.2f bytes/record)\n", in.index,
+         in.index ? (double)(in.size - strlen(COMMIT_LOG_MAGIC)) / in.index : 0.0);
+  std::vector<std::pair<uint32_t, uint64_t>> ops(op_count.begin(), op_count.end());
+  std::sort(ops.begin(), ops.end(), [](auto &a, auto &b) { return a.second > b.second; });
+  printf("\nopcode     count\n");
+  for (auto &o : ops) printf("  0x%02x  %10" PRIu64 "  %6.2f%%\n", o.first, o.second, o.second * 100.0 / in.index);
+
+  printf("\nprediction     total     correct     rate\n");
+  uint64_t all_t = 0, all_c = 0;
+  for (int k = 0; k < NR_KIND; k ++) {
+    all_t += total[k]; all_c += correct[k];
+    if (total[k]) printf("  %-10s %10" PRIu64 "  %10" PRIu64 "  %6.2f%%\n", kind_name[k], total[k], correct[k], correct[k] * 100.0 / total[k]);
+    else          printf("  %-10s %10d  %10d     N/A\n", kind_name[k], 0, 0);
+  }
+  if (all_t) printf("  %-10s %10" PRIu64 "  %10" PRIu64 "  %6.2f%%\n", "ALL", all_t, all_c, all_c * 100.0 / all_t);
+
+  std::vector<std::pair<uint32_t, std::pair<uint64_t, uint64_t>>> miss(pc_miss.begin(), pc_miss.end());
+  std::sort(miss.begin(), miss.end(), [](auto &a, auto &b) { return a.second.second > b.second.second; });
+  printf("\ntop mispredicted pcs\n");
+  for (size_t i = 0; i < miss.size() && i < top && miss[i].second.second; i ++) {
+    printf("  0x%08x  %10" PRIu64 " / %-10" PRIu64 "\n", miss[i].first, miss[i].second.second, miss[i].second.first);
+  }
+  return 0;
+}
+
+// ----------------------------------------------------------------- filter
+static int cmd_filter(int argc, char **argv) {
+  if (argc < 1) return -1;
+  uint64_t from = 0, to = UINT64_MAX;
+  uint32_t pc_lo = 0, pc_hi = UINT32_MAX, rd = 0;
+  int opcode = -1;
+  bool mispred = false;
+  for (int i = 1; i < argc; i ++) {
+    const char *v;
+    if ((v = arg_value(argv[i], "--from"))) from = strtoull(v, nullptr, 0);
+    else if ((v = arg_value(argv[i], "--to"))) to = strtoull(v, nullptr, 0);
+    else if ((v = arg_value(argv[i], "--opcode"))) opcode = strtol(v, nullptr, 0);
+    else if ((v = arg_value(argv[i], "--rd"))) rd = strtoul(v, nullptr, 0);
+    else if ((v = arg_value(argv[i], "--pc"))) {
+      char *colon;
+      pc_lo = pc_hi = strtoul(v, &colon, 0);
+      if (*colon == ':') pc_hi = strtoul(colon + 1, nullptr, 0);
+    }
+    else if (strcmp(argv[i], "--mispred") == 0) mispred = true;
+    else return -1;
+  }
+  LogReader in(argv[0]);
+  CommitRecord r;
+  while (in.next(&r)) {
+    uint64_t idx = in.index - 1;
+    if (idx < from) continue;
+    if (idx >= to) break;
+    if (r.pc < pc_lo || r.pc > pc_hi) continue;
+    if (opcode >= 0 && (int)(r.instr & 0x7f) != opcode) continue;
+    if (rd && r.rd != rd) continue;
+    if (mispred && r.pred_pc == r.next_pc) continue;
+    print_record(idx, r);
+  }
+  return 0;
+}
+
+// ----------------------------------------------------------------- diff
+// Architectural fields only: the predicted pc is expected to differ between
+// predictor designs, so a changed prediction is counted but not reported.
+static int cmd_diff(int argc, char **argv) {
+  if (argc < 2) return -1;
+  uint64_t max = 10;
+  for (int i = 2; i < argc; i ++) {
+    if (const char *v = arg_value(argv[i], "--max")) max = strtoull(v, nullptr, 0);
+    else return -1;
+  }
+  LogReader a(argv[0]), b(argv[1]);
+  CommitRecord ra, rb;
+  uint64_t ndiff = 0, npred = 0;
+  for (;;) {
+    bool ha = a.next(&ra), hb = b.next(&rb);
+    if (!ha || !hb) {
+      if (ha != hb) {
+        printf("length differs: %s ends at record %" PRIu64 "\n", ha ? argv[1] : argv[0], ha ? b.index : a.index);
+        ndiff ++;
+      }
+      break;
+    }
+    npred += (ra.pred_pc != rb.pred_pc);
+    if (ra.pc == rb.pc && ra.instr == rb.instr && ra.rd == rb.rd && ra.value == rb.value && ra.next_pc == rb.next_pc) continue;
+    if (ndiff ++ < max) {
+      printf("record %" PRIu64 " differs:\n  A", a.index - 1);
+      print_record(a.index - 1, ra);
+      printf("  B");
+      print_record(b.index - 1, rb);
+    }
+  }
+  printf("%" PRIu64 " records compared, %" PRIu64 " differ, %" PRIu64 " predictions differ\n",
+         std::min(a.index, b.index), ndiff, npred);
+  return ndiff ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  int ret = -1;
+  if (argc >= 2) {
+    if (strcmp(argv[1], "stat") == 0)        ret = cmd_stat(argc - 2, argv + 2);
+    else if (strcmp(argv[1], "filter") == 0) ret = cmd_filter(argc - 2, argv + 2);
+    else if (strcmp(argv[1], "diff") == 0)   ret = cmd_diff(argc - 2, argv + 2);
+  }
+  if (ret < 0) {
+    fprintf(stderr,
+        "Usage: %s stat   LOG [--top=N]\n"
+        "       %s filter LOG [--from=I] [--to=I] [--pc=LO[:HI]] [--opcode=OP] [--rd=N] [--mispred]\n"
+        "       %s diff   LOG_A LOG_B [--max=N]\n", argv[0], argv[0], argv[0]);
+    return 2;
+  }
+  return ret;
+}